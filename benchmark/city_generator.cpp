@@ -0,0 +1,249 @@
+#include "city_generator.h"
+#include "geo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace benchmark {
+
+namespace {
+
+// Шаг сетки остановок в градусах: около 450 м по широте
+constexpr double GRID_STEP = 0.004;
+constexpr double ORIGIN_LAT = 55.55;
+constexpr double ORIGIN_LNG = 37.35;
+// Доля запросов к несуществующим автобусам и остановкам
+constexpr double MISSING_NAME_SHARE = 0.05;
+
+std::string StopName(size_t index) {
+    return "Stop "s + std::to_string(index);
+}
+
+std::string BusName(size_t index) {
+    return "Bus "s + std::to_string(index);
+}
+
+json::Dict MakeDict(std::initializer_list<std::pair<const char*, json::Node>> items) {
+    json::Dict dict;
+    for (const auto& [key, value] : items) {
+        dict.emplace(key, value);
+    }
+    return dict;
+}
+
+json::Node MakeRenderSettings() {
+    return MakeDict({
+        {"width", 1200.0},
+        {"height", 1200.0},
+        {"padding", 50.0},
+        {"line_width", 14.0},
+        {"stop_radius", 5.0},
+        {"bus_label_font_size", 20},
+        {"bus_label_offset", json::Array{7.0, 15.0}},
+        {"stop_label_font_size", 18},
+        {"stop_label_offset", json::Array{7.0, -3.0}},
+        {"underlayer_color", json::Array{255, 255, 255, 0.85}},
+        {"underlayer_width", 3.0},
+        {"color_palette", json::Array{"green"s, json::Array{255, 160, 0}, "red"s}},
+    });
+}
+
+class CityGenerator {
+public:
+    explicit CityGenerator(const CityParams& params)
+        : params_(params)
+        , random_(params.seed)
+        , grid_side_(std::max<size_t>(static_cast<size_t>(std::ceil(std::sqrt(params.stop_count))), 1)) {
+    }
+
+    json::Document Generate() {
+        PlaceStops();
+        BuildRoutes();
+
+        json::Dict root;
+        root.emplace("base_requests", MakeBaseRequests());
+        root.emplace("render_settings", MakeRenderSettings());
+        root.emplace("routing_settings", MakeDict({{"bus_wait_time", 6}, {"bus_velocity", 40.0}}));
+        root.emplace("stat_requests", MakeStatRequests());
+        return json::Document(std::move(root));
+    }
+
+private:
+    void PlaceStops() {
+        std::uniform_real_distribution<double> jitter(-GRID_STEP / 3, GRID_STEP / 3);
+        coordinates_.reserve(params_.stop_count);
+        for (size_t i = 0; i < params_.stop_count; ++i) {
+            const double row = static_cast<double>(i / grid_side_);
+            const double column = static_cast<double>(i % grid_side_);
+            // Долгота растянута, чтобы на широте Москвы клетки были примерно квадратными
+            coordinates_.push_back({ORIGIN_LAT + row * GRID_STEP + jitter(random_),
+                                    ORIGIN_LNG + column * GRID_STEP * 1.7 + jitter(random_)});
+        }
+    }
+
+    // Следующая остановка случайного блуждания: одна из соседних по сетке,
+    // по возможности не та, откуда только что пришли
+    size_t NextStop(size_t current, size_t previous) {
+        const long row = static_cast<long>(current / grid_side_);
+        const long column = static_cast<long>(current % grid_side_);
+        std::vector<size_t> neighbours;
+        for (long dr = -1; dr <= 1; ++dr) {
+            for (long dc = -1; dc <= 1; ++dc) {
+                const long r = row + dr;
+                const long c = column + dc;
+                if ((dr == 0 && dc == 0) || r < 0 || c < 0 || c >= static_cast<long>(grid_side_)) {
+                    continue;
+                }
+                const size_t index = static_cast<size_t>(r) * grid_side_ + static_cast<size_t>(c);
+                if (index < params_.stop_count && index != previous) {
+                    neighbours.push_back(index);
+                }
+            }
+        }
+        if (neighbours.empty()) {
+            return previous;
+        }
+        return neighbours[std::uniform_int_distribution<size_t>(0, neighbours.size() - 1)(random_)];
+    }
+
+    void BuildRoutes() {
+        if (params_.stop_count < 2) {
+            return;
+        }
+        std::uniform_int_distribution<size_t> any_stop(0, params_.stop_count - 1);
+        std::uniform_int_distribution<size_t> route_length(
+            std::max<size_t>(params_.min_route_length, 2),
+            std::max(params_.max_route_length, std::max<size_t>(params_.min_route_length, 2)));
+        std::bernoulli_distribution is_roundtrip(0.5);
+        std::bernoulli_distribution has_road_distance(std::clamp(params_.road_distance_density, 0.0, 1.0));
+        std::uniform_real_distribution<double> detour(1.1, 1.4);
+
+        for (size_t bus = 0; bus < params_.bus_count; ++bus) {
+            Route route;
+            route.is_roundtrip = is_roundtrip(random_);
+            const size_t length = route_length(random_);
+
+            size_t current = any_stop(random_);
+            size_t previous = current;
+            route.stops.push_back(current);
+            while (route.stops.size() < (route.is_roundtrip ? length - 1 : length)) {
+                const size_t next = NextStop(current, previous);
+                previous = current;
+                current = next;
+                route.stops.push_back(current);
+            }
+            if (route.is_roundtrip) {
+                route.stops.push_back(route.stops.front());
+            }
+
+            for (size_t i = 1; i < route.stops.size(); ++i) {
+                const size_t from = route.stops[i - 1];
+                const size_t to = route.stops[i];
+                if (from != to && has_road_distance(random_)) {
+                    const double straight = ComputeDistance(coordinates_[from], coordinates_[to]);
+                    road_distances_[from].emplace(to, static_cast<int>(std::ceil(straight * detour(random_))));
+                }
+            }
+            routes_.push_back(std::move(route));
+        }
+    }
+
+    json::Array MakeBaseRequests() const {
+        json::Array requests;
+        requests.reserve(coordinates_.size() + routes_.size());
+        for (size_t i = 0; i < coordinates_.size(); ++i) {
+            json::Dict distances;
+            if (const auto it = road_distances_.find(i); it != road_distances_.end()) {
+                for (const auto& [to, meters] : it->second) {
+                    distances.emplace(StopName(to), meters);
+                }
+            }
+            requests.push_back(MakeDict({
+                {"type", "Stop"s},
+                {"name", StopName(i)},
+                {"latitude", coordinates_[i].lat},
+                {"longitude", coordinates_[i].lng},
+                {"road_distances", std::move(distances)},
+            }));
+        }
+        for (size_t i = 0; i < routes_.size(); ++i) {
+            const auto& route = routes_[i];
+            // Линейный маршрут задаётся в одну сторону, кольцевой — замкнутым
+            json::Array stops;
+            for (size_t stop : route.stops) {
+                stops.push_back(StopName(stop));
+            }
+            requests.push_back(MakeDict({
+                {"type", "Bus"s},
+                {"name", BusName(i)},
+                {"stops", std::move(stops)},
+                {"is_roundtrip", route.is_roundtrip},
+            }));
+        }
+        return requests;
+    }
+
+    json::Array MakeStatRequests() {
+        std::vector<json::Dict> requests;
+        std::bernoulli_distribution missing(MISSING_NAME_SHARE);
+        auto pick = [&](size_t count, auto make_name) {
+            if (count == 0 || missing(random_)) {
+                return "Missing "s + std::to_string(random_());
+            }
+            return make_name(std::uniform_int_distribution<size_t>(0, count - 1)(random_));
+        };
+
+        for (size_t i = 0; i < params_.bus_queries; ++i) {
+            requests.push_back(MakeDict({{"type", "Bus"s}, {"name", pick(routes_.size(), BusName)}}));
+        }
+        for (size_t i = 0; i < params_.stop_queries; ++i) {
+            requests.push_back(MakeDict({{"type", "Stop"s}, {"name", pick(coordinates_.size(), StopName)}}));
+        }
+        for (size_t i = 0; i < params_.route_queries; ++i) {
+            requests.push_back(MakeDict({
+                {"type", "Route"s},
+                {"from", pick(coordinates_.size(), StopName)},
+                {"to", pick(coordinates_.size(), StopName)},
+            }));
+        }
+        for (size_t i = 0; i < params_.map_queries; ++i) {
+            requests.push_back(MakeDict({{"type", "Map"s}}));
+        }
+
+        // Типы запросов перемешаны, как в реальном потоке
+        std::shuffle(requests.begin(), requests.end(), random_);
+        json::Array result;
+        result.reserve(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            requests[i].emplace("id", static_cast<int>(i + 1));
+            result.push_back(std::move(requests[i]));
+        }
+        return result;
+    }
+
+    struct Route {
+        std::vector<size_t> stops;
+        bool is_roundtrip = false;
+    };
+
+    const CityParams& params_;
+    std::mt19937 random_;
+    size_t grid_side_;
+    std::vector<Coordinates> coordinates_;
+    std::vector<Route> routes_;
+    std::map<size_t, std::map<size_t, int>> road_distances_;
+};
+
+}  // namespace
+
+json::Document GenerateCity(const CityParams& params) {
+    return CityGenerator(params).Generate();
+}
+
+}  // namespace benchmark
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstdint>
+
+namespace benchmark {
+
+// Параметры синтетического города
+struct CityParams {
+    size_t stop_count = 500;
+    size_t bus_count = 50;
+    // Длина маршрута в остановках выбирается равномерно из [min_route_length, max_route_length]
+    size_t min_route_length = 5;
+    size_t max_route_length = 30;
+    // Доля перегонов маршрутов, для которых задано дорожное расстояние;
+    // для остальных используется расстояние по прямой
+    double road_distance_density = 0.8;
+
+    size_t bus_queries = 1000;
+    size_t stop_queries = 1000;
+    size_t route_queries = 1000;
+    size_t map_queries = 1;
+
+    uint32_t seed = 1;
+};
+
+// Документ в формате входа программы: base_requests, render_settings,
+// routing_settings и stat_requests. Остановки лежат на сетке с небольшим
+// смещением, маршруты идут случайным блужданием к соседним остановкам,
+// поэтому карта и граф похожи на городские. Результат зависит только от params
+json::Document GenerateCity(const CityParams& params);
+
+}  // namespace benchmark
@@ -0,0 +1,209 @@
+#include "city_generator.h"
+
+#include "json.h"
+#include "json_reader.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std::literals;
+
+namespace {
+
+struct Options {
+    benchmark::CityParams city;
+    // --dump-input FILE: сохранить сгенерированный вход, чтобы прогнать его через основную программу
+    std::string dump_path;
+    json::PrintMode print_mode = json::PrintMode::PRETTY;
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    auto& city = options.city;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(std::string(arg) + " expects a value"s);
+            }
+            return argv[++i];
+        };
+        auto count = [&]() -> size_t {
+            return std::stoul(value());
+        };
+
+        if (arg == "--stops"sv) {
+            city.stop_count = count();
+        } else if (arg == "--buses"sv) {
+            city.bus_count = count();
+        } else if (arg == "--min-route"sv) {
+            city.min_route_length = count();
+        } else if (arg == "--max-route"sv) {
+            city.max_route_length = count();
+        } else if (arg == "--distance-density"sv) {
+            city.road_distance_density = std::stod(value());
+        } else if (arg == "--bus-queries"sv) {
+            city.bus_queries = count();
+        } else if (arg == "--stop-queries"sv) {
+            city.stop_queries = count();
+        } else if (arg == "--route-queries"sv) {
+            city.route_queries = count();
+        } else if (arg == "--map-queries"sv) {
+            city.map_queries = count();
+        } else if (arg == "--seed"sv) {
+            city.seed = static_cast<uint32_t>(count());
+        } else if (arg == "--dump-input"sv) {
+            options.dump_path = value();
+        } else if (arg == "--compact"sv) {
+            options.print_mode = json::PrintMode::COMPACT;
+        } else {
+            throw std::invalid_argument("Unknown option "s + std::string(arg));
+        }
+    }
+    return options;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double Milliseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Время каждого запроса одного типа
+struct QueryStats {
+    size_t count = 0;
+    Clock::duration total{};
+    Clock::duration max{};
+
+    void Add(Clock::duration duration) {
+        ++count;
+        total += duration;
+        max = std::max(max, duration);
+    }
+
+    json::Node ToJson() const {
+        json::Dict result;
+        result.emplace("count", static_cast<int>(count));
+        result.emplace("total_ms", Milliseconds(total));
+        result.emplace("mean_us", count ? Milliseconds(total) * 1000 / static_cast<double>(count) : 0.0);
+        result.emplace("max_us", Milliseconds(max) * 1000);
+        return result;
+    }
+};
+
+json::Node ParamsToJson(const benchmark::CityParams& city) {
+    json::Dict result;
+    result.emplace("stops", static_cast<int>(city.stop_count));
+    result.emplace("buses", static_cast<int>(city.bus_count));
+    result.emplace("min_route_length", static_cast<int>(city.min_route_length));
+    result.emplace("max_route_length", static_cast<int>(city.max_route_length));
+    result.emplace("road_distance_density", city.road_distance_density);
+    result.emplace("bus_queries", static_cast<int>(city.bus_queries));
+    result.emplace("stop_queries", static_cast<int>(city.stop_queries));
+    result.emplace("route_queries", static_cast<int>(city.route_queries));
+    result.emplace("map_queries", static_cast<int>(city.map_queries));
+    result.emplace("seed", static_cast<int>(city.seed));
+    return result;
+}
+
+}  // namespace
+
+// Генерирует синтетический город, прогоняет его через все этапы программы
+// и печатает время каждого этапа в JSON
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    json::Dict phases;
+    auto measure = [&phases](const char* name, auto&& phase) {
+        const auto start = Clock::now();
+        phase();
+        phases.emplace(name, Milliseconds(Clock::now() - start));
+    };
+
+    std::string input;
+    measure("generate_ms", [&] {
+        std::ostringstream out;
+        json::Print(benchmark::GenerateCity(options.city), out, json::PrintMode::COMPACT);
+        input = out.str();
+    });
+    if (!options.dump_path.empty()) {
+        std::ofstream(options.dump_path, std::ios::binary) << input;
+    }
+
+    json::Document doc{nullptr};
+    measure("parse_ms", [&] {
+        doc = json::Load(input);
+    });
+    const auto& root = doc.GetRoot().AsDict();
+
+    transport_catalogue::TransportCatalogue catalogue;
+    transport::RoutingSettings routing_settings;
+    const auto& routing = root.at("routing_settings").AsDict();
+    routing_settings.bus_wait_time = routing.at("bus_wait_time").AsInt();
+    routing_settings.bus_velocity = routing.at("bus_velocity").AsDouble();
+
+    transport::TransportRouter router(routing_settings, catalogue);
+    JsonReader reader(catalogue, router);
+
+    measure("base_requests_ms", [&] {
+        reader.ParsingBaseRequests(root.at("base_requests").AsArray());
+    });
+    measure("build_graph_ms", [&] {
+        router.BuildGraph();
+    });
+    measure("render_settings_ms", [&] {
+        reader.ParsingRenderSettings(root.at("render_settings").AsDict());
+    });
+
+    // Запросы выполняются в порядке входа, время копится по типам
+    std::map<std::string, QueryStats> query_stats;
+    json::Array responses;
+    measure("stat_requests_ms", [&] {
+        for (const auto& request : root.at("stat_requests").AsArray()) {
+            const auto& dict = request.AsDict();
+            const auto start = Clock::now();
+            responses.push_back(reader.ProcessStatRequest(dict));
+            query_stats[dict.at("type").AsString()].Add(Clock::now() - start);
+        }
+    });
+
+    size_t output_bytes = 0;
+    measure("print_ms", [&] {
+        std::ostringstream out;
+        json::Print(json::Document(std::move(responses)), out, options.print_mode);
+        output_bytes = out.str().size();
+    });
+
+    json::Dict queries;
+    for (const auto& [type, stats] : query_stats) {
+        queries.emplace(type, stats.ToJson());
+    }
+
+    json::Dict sizes;
+    sizes.emplace("input_bytes", static_cast<int>(input.size()));
+    sizes.emplace("output_bytes", static_cast<int>(output_bytes));
+
+    json::Dict result;
+    result.emplace("params", ParamsToJson(options.city));
+    result.emplace("phases", std::move(phases));
+    result.emplace("queries", std::move(queries));
+    result.emplace("sizes", std::move(sizes));
+    json::Print(json::Document(std::move(result)), std::cout, options.print_mode);
+    std::cout << std::endl;
+
+    return 0;
+}
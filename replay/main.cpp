@@ -0,0 +1,209 @@
+#include "json.h"
+#include "json_reader.h"
+#include "metrics.h"
+#include "query_server.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+struct Options {
+    // --base FILE: база с routing_settings и render_settings, как для основной программы
+    std::string base_path;
+    // --log FILE: журнал, записанный transport_catalogue --serve --capture
+    std::string log_path;
+    // --paced: запросы подаются с исходными интервалами, иначе — подряд без пауз
+    bool paced = false;
+    // --speed X: в режиме --paced интервалы сокращаются в X раз
+    double speed = 1.0;
+    // --responses FILE: ответы сохраняются, чтобы сравнить их между сборками
+    std::string responses_path;
+    json::PrintMode print_mode = json::PrintMode::PRETTY;
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(std::string(arg) + " expects a value"s);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--base"sv) {
+            options.base_path = value();
+        } else if (arg == "--log"sv) {
+            options.log_path = value();
+        } else if (arg == "--paced"sv) {
+            options.paced = true;
+        } else if (arg == "--speed"sv) {
+            options.speed = std::stod(value());
+        } else if (arg == "--responses"sv) {
+            options.responses_path = value();
+        } else if (arg == "--compact"sv) {
+            options.print_mode = json::PrintMode::COMPACT;
+        } else {
+            throw std::invalid_argument("Unknown option "s + std::string(arg));
+        }
+    }
+    if (options.base_path.empty() || options.log_path.empty()) {
+        throw std::invalid_argument("Usage: replay --base FILE --log FILE [--paced [--speed X]] "
+                                    "[--responses FILE] [--compact]"s);
+    }
+    if (!(options.speed > 0)) {
+        throw std::invalid_argument("--speed must be positive"s);
+    }
+    return options;
+}
+
+std::ifstream OpenInput(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Cannot open "s + path);
+    }
+    return input;
+}
+
+struct LoggedRequest {
+    std::chrono::microseconds arrival;
+    std::string line;
+    // Поле type запроса или "?", если строку не удалось разобрать
+    std::string type;
+};
+
+std::string RequestType(std::string_view line) {
+    try {
+        const auto doc = json::Load(line);
+        if (doc.GetRoot().IsDict()) {
+            const auto& request = doc.GetRoot().AsDict();
+            if (const auto it = request.find("type"); it != request.end() && it->second.IsString()) {
+                return it->second.AsString();
+            }
+        }
+    } catch (const json::ParsingError&) {
+    }
+    return "?"s;
+}
+
+std::vector<LoggedRequest> ReadLog(const std::string& path) {
+    auto input = OpenInput(path);
+    std::vector<LoggedRequest> requests;
+    size_t line_number = 0;
+    for (std::string line; std::getline(input, line);) {
+        ++line_number;
+        if (line.empty()) {
+            continue;
+        }
+        const auto captured = ParseCapturedRequest(line);
+        if (!captured) {
+            throw std::runtime_error(path + ":"s + std::to_string(line_number) + ": not a capture log line"s);
+        }
+        requests.push_back({std::chrono::microseconds(captured->arrival_us), std::string(captured->line),
+                            RequestType(captured->line)});
+    }
+    return requests;
+}
+
+}  // namespace
+
+// Воспроизводит журнал запросов на заданной базе и печатает в JSON пропускную
+// способность и перцентили задержек по типам запросов
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<LoggedRequest> log;
+    json::Document base{nullptr};
+    try {
+        options = ParseOptions(argc, argv);
+        log = ReadLog(options.log_path);
+        auto input = OpenInput(options.base_path);
+        base = json::Load(input);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    const auto& root = base.GetRoot().AsDict();
+
+    transport_catalogue::TransportCatalogue catalogue;
+    transport::RoutingSettings routing_settings;
+    if (root.count("routing_settings")) {
+        const auto& routing = root.at("routing_settings").AsDict();
+        routing_settings.bus_wait_time = routing.at("bus_wait_time").AsInt();
+        routing_settings.bus_velocity = routing.at("bus_velocity").AsDouble();
+    }
+    transport::TransportRouter router(routing_settings, catalogue);
+    JsonReader reader(catalogue, router);
+    if (root.count("base_requests")) {
+        reader.ParsingBaseRequests(root.at("base_requests").AsArray());
+    }
+    router.BuildGraph();
+    if (root.count("render_settings")) {
+        reader.ParsingRenderSettings(root.at("render_settings").AsDict());
+    }
+
+    std::ofstream responses;
+    if (!options.responses_path.empty()) {
+        responses.open(options.responses_path, std::ios::binary);
+        if (!responses) {
+            std::cerr << "Cannot open "s << options.responses_path << std::endl;
+            return 1;
+        }
+    }
+
+    // Время обработки запроса сервером и, в режиме --paced, время от запланированного
+    // прихода до ответа: если сервер не успевает, запросы ждут в очереди
+    metrics::RequestLatencies service_latencies;
+    metrics::RequestLatencies response_latencies;
+    QueryServer server(reader, &service_latencies);
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    const auto first_arrival = log.empty() ? std::chrono::microseconds(0) : log.front().arrival;
+    Clock::duration max_lag{};
+    for (const auto& request : log) {
+        Clock::time_point scheduled = Clock::now();
+        if (options.paced) {
+            scheduled = start + std::chrono::duration_cast<Clock::duration>(
+                                    (request.arrival - first_arrival) / options.speed);
+            std::this_thread::sleep_until(scheduled);
+            max_lag = std::max(max_lag, Clock::now() - scheduled);
+        }
+
+        const std::string response = server.HandleLine(request.line);
+
+        if (options.paced) {
+            response_latencies.Record(request.type, std::nullopt, Clock::now() - scheduled);
+        }
+        if (responses.is_open()) {
+            responses << response << '\n';
+        }
+    }
+    const double wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    json::Dict result;
+    result.emplace("mode", options.paced ? "paced"s : "max_throughput"s);
+    result.emplace("requests", static_cast<int>(log.size()));
+    result.emplace("wall_ms", wall_seconds * 1000);
+    result.emplace("throughput_rps", wall_seconds > 0 ? static_cast<double>(log.size()) / wall_seconds : 0.0);
+    result.emplace("service", service_latencies.ToJson());
+    if (options.paced) {
+        result.emplace("speed", options.speed);
+        result.emplace("response", response_latencies.ToJson());
+        result.emplace("max_lag_ms", std::chrono::duration<double, std::milli>(max_lag).count());
+    }
+    json::Print(json::Document(std::move(result)), std::cout, options.print_mode);
+    std::cout << std::endl;
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Замена глобальных operator new/delete, чтобы metrics::Recorder считал аллокации
+// по этапам. Отдельная единица трансляции: её компонует только основная программа,
+// а benchmark и replay работают со стандартным распределителем
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Как стандартный operator new: пока malloc не справляется, вызывается
+// new_handler, который может освободить память; без него — bad_alloc
+template <typename TryAllocate>
+void* AllocateOrHandle(TryAllocate try_allocate) {
+    metrics::CountAllocation();
+    while (true) {
+        if (void* ptr = try_allocate()) {
+            return ptr;
+        }
+        const std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* Allocate(std::size_t size) {
+    return AllocateOrHandle([size] {
+        return std::malloc(size == 0 ? 1 : size);
+    });
+}
+
+void* AllocateAligned(std::size_t size, std::align_val_t alignment) {
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc требует размер, кратный выравниванию
+    const std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+    return AllocateOrHandle([align, rounded] {
+        return std::aligned_alloc(align, rounded);
+    });
+}
+
+}  // namespace
+
+// Остальные формы (nothrow, массивы) по умолчанию вызывают эти
+void* operator new(std::size_t size) {
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
@@ -0,0 +1,271 @@
+#include "connection_scan.h"
+#include "geo.h"
+#include "memory_report.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace transport {
+
+namespace {
+
+constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+constexpr uint32_t NO_CONNECTION = std::numeric_limits<uint32_t>::max();
+
+}  // namespace
+
+ConnectionScanRouter::ConnectionScanRouter(const transport_catalogue::TransportCatalogue& catalogue,
+                                           double velocity_meters_per_minute) {
+    TRACE_SCOPE("ConnectionScanRouter");
+    for (const auto& stop : catalogue.GetStops()) {
+        stop_ids_.emplace(&stop, static_cast<uint32_t>(stops_.size()));
+        stops_.push_back(&stop);
+    }
+
+    auto segment_time = [&](const transport_catalogue::Stop* from, const transport_catalogue::Stop* to) {
+        int distance = catalogue.GetDistance(from, to);
+        if (distance == 0) {
+            distance = static_cast<int>(ComputeDistance(from->coordinates, to->coordinates));
+        }
+        return distance / velocity_meters_per_minute;
+    };
+
+    for (const auto& bus : catalogue.GetBuses()) {
+        const auto& stops = bus.stops;
+        if (bus.departures.empty() || stops.size() < 2) {
+            continue;
+        }
+        // Время от отправления до каждой остановки одинаково для всех рейсов
+        std::vector<double> forward_offsets(stops.size(), 0.0);
+        for (size_t i = 1; i < stops.size(); ++i) {
+            forward_offsets[i] = forward_offsets[i - 1] + segment_time(stops[i - 1], stops[i]);
+        }
+        std::vector<double> backward_offsets(stops.size(), 0.0);
+        if (!bus.is_roundtrip) {
+            for (size_t i = stops.size() - 1; i > 0; --i) {
+                backward_offsets[i - 1] = backward_offsets[i] + segment_time(stops[i], stops[i - 1]);
+            }
+        }
+
+        for (const double departure : bus.departures) {
+            const auto trip = static_cast<uint32_t>(trips_.size());
+            trips_.push_back({&bus, false});
+            for (size_t i = 0; i + 1 < stops.size(); ++i) {
+                connections_.push_back({departure + forward_offsets[i], departure + forward_offsets[i + 1],
+                                        stop_ids_.at(stops[i]), stop_ids_.at(stops[i + 1]),
+                                        trip, static_cast<uint32_t>(i)});
+            }
+            if (bus.is_roundtrip) {
+                continue;
+            }
+            const auto back_trip = static_cast<uint32_t>(trips_.size());
+            trips_.push_back({&bus, true});
+            for (size_t i = stops.size() - 1; i > 0; --i) {
+                connections_.push_back({departure + backward_offsets[i], departure + backward_offsets[i - 1],
+                                        stop_ids_.at(stops[i]), stop_ids_.at(stops[i - 1]),
+                                        back_trip, static_cast<uint32_t>(i)});
+            }
+        }
+    }
+
+    // Перегоны рейса с равным временем отправления (нулевой длины) сохраняют порядок
+    std::stable_sort(connections_.begin(), connections_.end(), [](const Connection& lhs, const Connection& rhs) {
+        return lhs.departure < rhs.departure;
+    });
+}
+
+std::optional<ConnectionScanRouter::Journey> ConnectionScanRouter::FindJourney(
+        const transport_catalogue::Stop* from,
+        const transport_catalogue::Stop* to,
+        double departure_time) const {
+    const auto from_it = stop_ids_.find(from);
+    const auto to_it = stop_ids_.find(to);
+    if (from_it == stop_ids_.end() || to_it == stop_ids_.end()) {
+        return std::nullopt;
+    }
+    if (from == to) {
+        return Journey{departure_time, departure_time, {}};
+    }
+    const uint32_t source = from_it->second;
+    const uint32_t target = to_it->second;
+
+    // Для каждой остановки — самое раннее прибытие и поездка, которой оно достигнуто:
+    // перегон посадки и перегон высадки
+    std::vector<double> arrival(stops_.size(), UNREACHED);
+    std::vector<std::pair<uint32_t, uint32_t>> reached_by(stops_.size(), {NO_CONNECTION, NO_CONNECTION});
+    // Перегон, на котором сели в рейс, или NO_CONNECTION, если в рейс ещё не сели
+    std::vector<uint32_t> boarded_at(trips_.size(), NO_CONNECTION);
+    arrival[source] = departure_time;
+
+    auto it = std::lower_bound(connections_.begin(), connections_.end(), departure_time,
+                               [](const Connection& connection, double time) {
+                                   return connection.departure < time;
+                               });
+    for (; it != connections_.end(); ++it) {
+        const Connection& connection = *it;
+        // Перегоны дальше отправляются позже, чем мы уже можем приехать
+        if (arrival[target] <= connection.departure) {
+            break;
+        }
+        uint32_t& boarding = boarded_at[connection.trip];
+        if (boarding == NO_CONNECTION) {
+            if (arrival[connection.from_stop] > connection.departure) {
+                continue;
+            }
+            boarding = static_cast<uint32_t>(it - connections_.begin());
+        }
+        if (connection.arrival < arrival[connection.to_stop]) {
+            arrival[connection.to_stop] = connection.arrival;
+            reached_by[connection.to_stop] = {boarding, static_cast<uint32_t>(it - connections_.begin())};
+        }
+    }
+    if (arrival[target] == UNREACHED) {
+        return std::nullopt;
+    }
+
+    Journey journey{departure_time, arrival[target], {}};
+    for (uint32_t stop = target; stop != source;) {
+        const auto [board, alight] = reached_by[stop];
+        journey.legs.push_back(MakeLeg(board, alight));
+        stop = connections_[board].from_stop;
+    }
+    std::reverse(journey.legs.begin(), journey.legs.end());
+    return journey;
+}
+
+std::vector<ConnectionScanRouter::Journey> ConnectionScanRouter::FindParetoJourneys(
+        const transport_catalogue::Stop* from,
+        const transport_catalogue::Stop* to,
+        double departure_time, size_t max_rides) const {
+    const auto from_it = stop_ids_.find(from);
+    const auto to_it = stop_ids_.find(to);
+    if (from_it == stop_ids_.end() || to_it == stop_ids_.end()) {
+        return {};
+    }
+    if (from == to) {
+        return {Journey{departure_time, departure_time, {}}};
+    }
+    const uint32_t source = from_it->second;
+    const uint32_t target = to_it->second;
+
+    // Поездка, которой достигнуто прибытие, и число поездок на пути с ней
+    struct Reached {
+        uint32_t board = NO_CONNECTION;
+        uint32_t alight = NO_CONNECTION;
+        uint32_t rides = 0;
+    };
+    // arrival[k][s] — самое раннее прибытие в s не более чем за k поездок
+    std::vector<std::vector<double>> arrival(max_rides + 1, std::vector<double>(stops_.size(), UNREACHED));
+    std::vector<std::vector<Reached>> reached_by(max_rides + 1, std::vector<Reached>(stops_.size()));
+    for (auto& level : arrival) {
+        level[source] = departure_time;
+    }
+    // Для каждого рейса — перегон посадки с наименьшим числом поездок до неё
+    std::vector<Reached> boarded(trips_.size());
+
+    auto it = std::lower_bound(connections_.begin(), connections_.end(), departure_time,
+                               [](const Connection& connection, double time) {
+                                   return connection.departure < time;
+                               });
+    for (; max_rides > 0 && it != connections_.end(); ++it) {
+        const Connection& connection = *it;
+        // Быстрее всех остальных вариантов приезжает тот, где поездок больше всего
+        // допустимого, а медленнее всех — с одной поездкой
+        if (arrival[1][target] <= connection.departure) {
+            break;
+        }
+        const auto index = static_cast<uint32_t>(it - connections_.begin());
+        Reached& trip = boarded[connection.trip];
+        for (uint32_t rides = 1; rides <= max_rides && (trip.board == NO_CONNECTION || rides < trip.rides); ++rides) {
+            if (arrival[rides - 1][connection.from_stop] <= connection.departure) {
+                trip = {index, index, rides};
+                break;
+            }
+        }
+        if (trip.board == NO_CONNECTION) {
+            continue;
+        }
+        for (size_t rides = trip.rides; rides <= max_rides && connection.arrival < arrival[rides][connection.to_stop];
+             ++rides) {
+            arrival[rides][connection.to_stop] = connection.arrival;
+            reached_by[rides][connection.to_stop] = {trip.board, index, trip.rides};
+        }
+    }
+
+    std::vector<Journey> journeys;
+    double best_arrival = UNREACHED;
+    for (size_t rides = 1; rides <= max_rides; ++rides) {
+        if (!(arrival[rides][target] < best_arrival)) {
+            continue;
+        }
+        best_arrival = arrival[rides][target];
+
+        Journey journey{departure_time, best_arrival, {}};
+        size_t level = rides;
+        for (uint32_t stop = target; stop != source;) {
+            const Reached& reached = reached_by[level][stop];
+            journey.legs.push_back(MakeLeg(reached.board, reached.alight));
+            stop = connections_[reached.board].from_stop;
+            level = reached.rides - 1;
+        }
+        std::reverse(journey.legs.begin(), journey.legs.end());
+        journeys.push_back(std::move(journey));
+    }
+    return journeys;
+}
+
+std::vector<std::pair<const transport_catalogue::Stop*, double>> ConnectionScanRouter::FindArrivals(
+        const transport_catalogue::Stop* from, double departure_time, double latest_arrival) const {
+    const auto from_it = stop_ids_.find(from);
+    if (from_it == stop_ids_.end()) {
+        return {};
+    }
+    std::vector<double> arrival(stops_.size(), UNREACHED);
+    std::vector<char> boarded(trips_.size(), 0);
+    arrival[from_it->second] = departure_time;
+
+    auto it = std::lower_bound(connections_.begin(), connections_.end(), departure_time,
+                               [](const Connection& connection, double time) {
+                                   return connection.departure < time;
+                               });
+    // Перегоны, отправляющиеся после latest_arrival, уже никуда не успевают
+    for (; it != connections_.end() && it->departure <= latest_arrival; ++it) {
+        const Connection& connection = *it;
+        char& on_board = boarded[connection.trip];
+        if (!on_board) {
+            if (arrival[connection.from_stop] > connection.departure) {
+                continue;
+            }
+            on_board = 1;
+        }
+        if (connection.arrival <= latest_arrival) {
+            arrival[connection.to_stop] = std::min(arrival[connection.to_stop], connection.arrival);
+        }
+    }
+
+    std::vector<std::pair<const transport_catalogue::Stop*, double>> result;
+    for (size_t stop = 0; stop < stops_.size(); ++stop) {
+        if (arrival[stop] != UNREACHED) {
+            result.emplace_back(stops_[stop], arrival[stop]);
+        }
+    }
+    return result;
+}
+
+ConnectionScanRouter::Leg ConnectionScanRouter::MakeLeg(uint32_t board, uint32_t alight) const {
+    const Connection& first = connections_[board];
+    const Connection& last = connections_[alight];
+    const Trip& trip = trips_[first.trip];
+    const size_t span_count = trip.backward ? first.stop_index - last.stop_index + 1
+                                            : last.stop_index - first.stop_index + 1;
+    return {trip.bus, first.stop_index, span_count, trip.backward,
+            stops_[first.from_stop], first.departure, last.arrival};
+}
+
+size_t ConnectionScanRouter::GetMemoryUsage() const {
+    return memory::HeapBytes(stops_) + memory::HashTableBytes(stop_ids_)
+           + memory::HeapBytes(trips_) + memory::HeapBytes(connections_);
+}
+
+}  // namespace transport
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace transport {
+
+// Маршрутизация по расписанию алгоритмом Connection Scan. Каждый рейс автобуса
+// разбит на перегоны (connections) с временами отправления и прибытия; все перегоны
+// лежат в одном массиве по возрастанию отправления, и запрос просматривает его
+// один раз подряд от момента отправления, пока не станет ясно, что раньше
+// в пункт назначения не попасть.
+//
+// Рейсы строятся по bus.departures: кольцевой маршрут отправляется от первой
+// остановки, линейный — в эти же моменты от обеих конечных. Время в минутах
+// от начала суток, время перегона — расстояние, делённое на скорость.
+class ConnectionScanRouter {
+public:
+    ConnectionScanRouter(const transport_catalogue::TransportCatalogue& catalogue,
+                         double velocity_meters_per_minute);
+
+    // Поездка одним рейсом: от bus->stops[first_stop_index] на span_count перегонов
+    struct Leg {
+        const transport_catalogue::Bus* bus;
+        size_t first_stop_index;
+        size_t span_count;
+        bool backward;
+        const transport_catalogue::Stop* from_stop;
+        double board_time;
+        double alight_time;
+    };
+
+    struct Journey {
+        double departure_time;
+        double arrival_time;
+        std::vector<Leg> legs;
+    };
+
+    // Самое раннее прибытие в to при отправлении из from не раньше departure_time
+    std::optional<Journey> FindJourney(const transport_catalogue::Stop* from,
+                                       const transport_catalogue::Stop* to,
+                                       double departure_time) const;
+
+    // Парето-множество по (время прибытия, число поездок) среди маршрутов не более
+    // чем из max_rides поездок, по возрастанию числа поездок
+    std::vector<Journey> FindParetoJourneys(const transport_catalogue::Stop* from,
+                                            const transport_catalogue::Stop* to,
+                                            double departure_time, size_t max_rides) const;
+
+    // Самое раннее прибытие на каждую остановку, куда можно попасть из from
+    // не позже latest_arrival при отправлении не раньше departure_time; from — с
+    // временем departure_time. Порядок остановок не задан
+    std::vector<std::pair<const transport_catalogue::Stop*, double>> FindArrivals(
+            const transport_catalogue::Stop* from, double departure_time, double latest_arrival) const;
+
+    size_t GetConnectionCount() const {
+        return connections_.size();
+    }
+
+    size_t GetMemoryUsage() const;
+
+private:
+    // Перегон рейса trip от stop_index-й остановки автобуса к соседней
+    struct Connection {
+        double departure;
+        double arrival;
+        uint32_t from_stop;
+        uint32_t to_stop;
+        uint32_t trip;
+        uint32_t stop_index;
+    };
+
+    struct Trip {
+        const transport_catalogue::Bus* bus;
+        bool backward;
+    };
+
+    // Поездка одним рейсом по перегонам от board до alight включительно
+    Leg MakeLeg(uint32_t board, uint32_t alight) const;
+
+    std::vector<const transport_catalogue::Stop*> stops_;
+    std::unordered_map<const transport_catalogue::Stop*, uint32_t> stop_ids_;
+    std::vector<Trip> trips_;
+    std::vector<Connection> connections_;
+};
+
+}  // namespace transport
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "memory_report.h"
 #include "ranges.h"
 
 #include <cstdlib>
@@ -33,6 +34,9 @@ public:
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    // Байт в рёбрах и списках смежности
+    size_t GetMemoryUsage() const;
+
 private:
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
@@ -71,4 +75,13 @@ typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
     return ranges::AsRange(incidence_lists_.at(vertex));
 }
-}  // namespace graph
\ No newline at end of file
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetMemoryUsage() const {
+    size_t bytes = memory::HeapBytes(edges_) + memory::HeapBytes(incidence_lists_);
+    for (const auto& list : incidence_lists_) {
+        bytes += memory::HeapBytes(list);
+    }
+    return bytes;
+}
+
+}  // namespace graph
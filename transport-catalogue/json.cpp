@@ -1,80 +1,247 @@
 #include "json.h"
+#include "json_index.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <charconv>
 #include <iterator>
+#include <optional>
+#include <string_view>
 
 namespace json {
 
 namespace {
 using namespace std::literals;
 
-Node LoadNode(std::istream& input);
-Node LoadString(std::istream& input);
+bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
 
-std::string LoadLiteral(std::istream& input) {
-    std::string s;
-    while (std::isalpha(input.peek())) {
-        s.push_back(static_cast<char>(input.get()));
+Node MakeDict(Dict::Storage items) {
+    // Ключи сортируются один раз после чтения всего объекта, дубликаты оказываются соседями
+    std::sort(items.begin(), items.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    auto duplicate = std::adjacent_find(items.begin(), items.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+    });
+    if (duplicate != items.end()) {
+        throw ParsingError("Duplicate key '"s + duplicate->first + "' have been found");
     }
-    return s;
+    return Node(Dict(std::move(items)));
 }
 
-Node LoadArray(std::istream& input) {
-    std::vector<Node> result;
+// Вторая стадия разбора: дерево строится переходами по индексу структурных символов
+// (см. BuildStructuralIndex), содержимое документа читается только внутри строк и чисел
+class Parser {
+public:
+    Parser(std::string_view text, const std::vector<uint32_t>& index)
+        : text_(text)
+        , index_(index) {
+    }
 
-    for (char c; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
+    Node ParseNode() {
+        if (AtEnd()) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (Current()) {
+            case '[':
+                return ParseArray();
+            case '{':
+                return ParseDict();
+            case '"':
+                return Node(ParseString());
+            case 't':
+                [[fallthrough]];
+            case 'f':
+                return ParseBool();
+            case 'n':
+                return ParseNull();
+            default:
+                return ParseNumber();
         }
-        result.push_back(LoadNode(input));
     }
-    if (!input) {
-        throw ParsingError("Array parsing error"s);
+
+private:
+    bool AtEnd() const {
+        return pos_ >= index_.size();
+    }
+
+    char Current() const {
+        return text_[index_[pos_]];
     }
-    return Node(std::move(result));
-}
 
-Node LoadDict(std::istream& input) {
-    Dict dict;
+    // Большие массивы верхних уровней (например, base_requests) разбираются кусками
+    // в нескольких потоках; вложенные в них элементы — уже последовательно
+    static constexpr size_t MAX_PARALLEL_DEPTH = 1;
+    static constexpr size_t MIN_PARALLEL_INDEX_SIZE = 1 << 16;
+    static constexpr size_t MIN_ELEMENTS_PER_THREAD = 256;
+
+    Node ParseArray() {
+        if (allow_parallel_ && depth_ <= MAX_PARALLEL_DEPTH
+            && index_.size() - pos_ >= MIN_PARALLEL_INDEX_SIZE) {
+            if (auto result = TryParseArrayInParallel()) {
+                return std::move(*result);
+            }
+        }
+
+        ++pos_;
+        Array result;
+        if (!AtEnd() && Current() == ']') {
+            ++pos_;
+            return Node(std::move(result));
+        }
+        ++depth_;
+        while (true) {
+            result.push_back(ParseNode());
+            if (AtEnd()) {
+                throw ParsingError("Array parsing error"s);
+            }
+            const char c = text_[index_[pos_++]];
+            if (c == ']') {
+                break;
+            }
+            if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        --depth_;
+        return Node(std::move(result));
+    }
 
-    for (char c; input >> c && c != '}';) {
-        if (c == '"') {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
+    // Находит по индексу границы элементов массива и разбирает их кусками параллельно.
+    // Куски склеиваются в исходном порядке, так что дерево совпадает с последовательным
+    // разбором. Если массив слишком мал или некорректен, возвращает nullopt: тогда его
+    // разбирает последовательный код, который и сообщит о точной ошибке
+    std::optional<Node> TryParseArrayInParallel() {
+        std::vector<size_t> element_starts{pos_ + 1};
+        size_t array_end = pos_ + 1;
+        for (size_t depth = 0;; ++array_end) {
+            if (array_end >= index_.size()) {
+                return std::nullopt;
+            }
+            const char c = text_[index_[array_end]];
+            if (c == '[' || c == '{') {
+                ++depth;
+            } else if (c == ']' || c == '}') {
+                if (depth == 0) {
+                    break;
                 }
-                dict.emplace(std::move(key), LoadNode(input));
-            } else {
-                throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                --depth;
+            } else if (c == ',' && depth == 0) {
+                element_starts.push_back(array_end + 1);
             }
-        } else if (c != ',') {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
         }
+
+        const size_t element_count = element_starts.size();
+        const size_t chunk_count = parallel::ChooseThreadCount(element_count, MIN_ELEMENTS_PER_THREAD);
+        if (chunk_count < 2) {
+            return std::nullopt;
+        }
+
+        std::vector<Array> chunks(chunk_count);
+        try {
+            parallel::ForEachChunk(element_count, chunk_count, [&](size_t chunk, size_t first, size_t last) {
+                Parser worker(text_, index_);
+                worker.allow_parallel_ = false;
+                worker.depth_ = depth_ + 1;
+                Array& elements = chunks[chunk];
+                elements.reserve(last - first);
+                for (size_t element = first; element < last; ++element) {
+                    worker.pos_ = element_starts[element];
+                    elements.push_back(worker.ParseNode());
+                    // Элемент должен закончиться ровно на запятой перед следующим или на ']'
+                    const size_t expected_end = element + 1 < element_count
+                        ? element_starts[element + 1] - 1
+                        : array_end;
+                    if (worker.pos_ != expected_end) {
+                        throw ParsingError("Array parsing error"s);
+                    }
+                }
+            });
+        } catch (const ParsingError&) {
+            return std::nullopt;
+        }
+        if (text_[index_[array_end]] != ']') {
+            return std::nullopt;
+        }
+
+        Array result;
+        result.reserve(element_count);
+        for (auto& elements : chunks) {
+            std::move(elements.begin(), elements.end(), std::back_inserter(result));
+        }
+        pos_ = array_end + 1;
+        return Node(std::move(result));
     }
-    if (!input) {
-        throw ParsingError("Dictionary parsing error"s);
+
+    Node ParseDict() {
+        ++pos_;
+        Dict::Storage items;
+        if (!AtEnd() && Current() == '}') {
+            ++pos_;
+            return Node(Dict{});
+        }
+        ++depth_;
+        while (true) {
+            if (AtEnd()) {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+            if (const char c = Current(); c != '"') {
+                throw ParsingError(R"('"' is expected but ')"s + c + "' has been found"s);
+            }
+            std::string key = ParseString();
+            if (AtEnd()) {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+            if (const char c = text_[index_[pos_++]]; c != ':') {
+                throw ParsingError(": is expected but '"s + c + "' has been found"s);
+            }
+            items.emplace_back(std::move(key), ParseNode());
+
+            if (AtEnd()) {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+            const char c = text_[index_[pos_++]];
+            if (c == '}') {
+                break;
+            }
+            if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        --depth_;
+        return MakeDict(std::move(items));
     }
-    return Node(std::move(dict));
-}
 
-Node LoadString(std::istream& input) {
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true) {
-        if (it == end) {
-            throw ParsingError("String parsing error");
+    std::string ParseString() {
+        // Внутри строки ничего не индексируется, поэтому закрывающая кавычка — следующая позиция
+        if (pos_ + 1 >= index_.size()) {
+            throw ParsingError("String parsing error"s);
         }
-        const char ch = *it;
-        if (ch == '"') {
-            ++it;
-            break;
-        } else if (ch == '\\') {
-            ++it;
-            if (it == end) {
-                throw ParsingError("String parsing error");
+        const size_t begin = index_[pos_] + 1;
+        const std::string_view raw = text_.substr(begin, index_[pos_ + 1] - begin);
+        pos_ += 2;
+
+        std::string s;
+        s.reserve(raw.size());
+        // Участки без спецсимволов копируются целиком
+        size_t run_begin = 0;
+        for (size_t i = 0; i < raw.size(); ++i) {
+            const char ch = raw[i];
+            if (ch != '\\' && ch != '\n' && ch != '\r') {
+                continue;
+            }
+            s.append(raw.substr(run_begin, i - run_begin));
+            if (ch != '\\') {
+                throw ParsingError("Unexpected end of line"s);
             }
-            const char escaped_char = *(it);
+            // Закрывающая кавычка не может быть экранирована, поэтому за слешем всегда есть символ
+            const char escaped_char = raw[++i];
             switch (escaped_char) {
                 case 'n':
                     s.push_back('\n');
@@ -94,243 +261,370 @@ Node LoadString(std::istream& input) {
                 default:
                     throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
             }
-        } else if (ch == '\n' || ch == '\r') {
-            throw ParsingError("Unexpected end of line"s);
-        } else {
-            s.push_back(ch);
+            run_begin = i + 1;
         }
-        ++it;
+        s.append(raw.substr(run_begin));
+        return s;
     }
 
-    return Node(std::move(s));
-}
+    // Литерал или число — символы от текущей позиции до пробела или следующего структурного символа
+    std::string_view ParseScalarToken() {
+        const size_t begin = index_[pos_];
+        const size_t limit = pos_ + 1 < index_.size() ? index_[pos_ + 1] : text_.size();
+        size_t end = begin;
+        while (end < limit && !IsWhitespace(text_[end])) {
+            ++end;
+        }
+        ++pos_;
+        return text_.substr(begin, end - begin);
+    }
 
-Node LoadBool(std::istream& input) {
-    const auto s = LoadLiteral(input);
-    if (s == "true"sv) {
-        return Node{true};
-    } else if (s == "false"sv) {
-        return Node{false};
-    } else {
-        throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+    Node ParseBool() {
+        const auto s = ParseScalarToken();
+        if (s == "true"sv) {
+            return Node{true};
+        } else if (s == "false"sv) {
+            return Node{false};
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
+        }
     }
-}
 
-Node LoadNull(std::istream& input) {
-    if (auto literal = LoadLiteral(input); literal == "null"sv) {
-        return Node{nullptr};
-    } else {
-        throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+    Node ParseNull() {
+        if (auto literal = ParseScalarToken(); literal == "null"sv) {
+            return Node{nullptr};
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
     }
-}
 
-Node LoadNumber(std::istream& input) {
-    std::string parsed_num;
+    Node ParseNumber() {
+        const std::string_view parsed_num = ParseScalarToken();
+        size_t i = 0;
+
+        // Пропускает одну или более цифр
+        auto read_digits = [&parsed_num, &i] {
+            if (i >= parsed_num.size() || !IsDigit(parsed_num[i])) {
+                throw ParsingError("A digit is expected"s);
+            }
+            while (i < parsed_num.size() && IsDigit(parsed_num[i])) {
+                ++i;
+            }
+        };
+        auto peek = [&parsed_num, &i] {
+            return i < parsed_num.size() ? parsed_num[i] : '\0';
+        };
+
+        if (peek() == '-') {
+            ++i;
+        }
+        // Парсим целую часть числа
+        if (peek() == '0') {
+            ++i;
+            // После 0 в JSON не могут идти другие цифры
+        } else {
+            read_digits();
+        }
 
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
+        bool is_int = true;
+        // Парсим дробную часть числа
+        if (peek() == '.') {
+            ++i;
+            read_digits();
+            is_int = false;
         }
-    };
 
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
-            throw ParsingError("A digit is expected"s);
+        // Парсим экспоненциальную часть числа
+        if (char ch = peek(); ch == 'e' || ch == 'E') {
+            ++i;
+            if (ch = peek(); ch == '+' || ch == '-') {
+                ++i;
+            }
+            read_digits();
+            is_int = false;
         }
-        while (std::isdigit(input.peek())) {
-            read_char();
+
+        const char* first = parsed_num.data();
+        const char* last = first + parsed_num.size();
+        if (i == parsed_num.size()) {
+            if (is_int) {
+                // При переполнении int число читается как double
+                int value;
+                if (auto [ptr, ec] = std::from_chars(first, last, value); ec == std::errc{}) {
+                    return value;
+                }
+            }
+            double value;
+            if (auto [ptr, ec] = std::from_chars(first, last, value); ec == std::errc{}) {
+                return value;
+            }
         }
+        throw ParsingError("Failed to convert "s + std::string(parsed_num) + " to number"s);
+    }
+
+    std::string_view text_;
+    const std::vector<uint32_t>& index_;
+    size_t pos_ = 0;
+    size_t depth_ = 0;
+    bool allow_parallel_ = true;
+};
+
+// Текст ровно одного значения из потока. Поток читается только до конца значения,
+// так что следующие за ним данные остаются в потоке, как при посимвольном разборе.
+// Некорректный текст не проверяется: ошибку найдёт разбор
+std::string ReadValue(std::istream& input) {
+    std::string text;
+    std::streambuf* buffer = input.rdbuf();
+    constexpr int END_OF_STREAM = std::char_traits<char>::eof();
+    auto is_space = [](int c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
     };
 
-    if (input.peek() == '-') {
-        read_char();
-    }
-    // Парсим целую часть числа
-    if (input.peek() == '0') {
-        read_char();
-        // После 0 в JSON не могут идти другие цифры
-    } else {
-        read_digits();
+    int c = buffer->sgetc();
+    while (c != END_OF_STREAM && is_space(c)) {
+        c = buffer->snextc();
     }
-
-    bool is_int = true;
-    // Парсим дробную часть числа
-    if (input.peek() == '.') {
-        read_char();
-        read_digits();
-        is_int = false;
+    if (c == END_OF_STREAM) {
+        input.setstate(std::ios::eofbit);
+        return text;
     }
 
-    // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
-            read_char();
-        }
-        read_digits();
-        is_int = false;
-    }
-
-    try {
-        if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
+    if (c == '{' || c == '[' || c == '"') {
+        // Массив, словарь или строка заканчиваются закрывающим символом на нулевой глубине
+        size_t depth = 0;
+        bool in_string = false;
+        bool escaped = false;
+        while ((c = buffer->sbumpc()) != END_OF_STREAM) {
+            text += static_cast<char>(c);
+            if (in_string) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == '"') {
+                    in_string = false;
+                }
+            } else if (c == '"') {
+                in_string = true;
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                --depth;
+            }
+            if (!in_string && depth == 0) {
+                return text;
             }
         }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+    } else {
+        // Число или литерал продолжается до разделителя
+        while (c != END_OF_STREAM && !is_space(c) && c != ',' && c != ']' && c != '}' && c != '{' && c != '[' && c != '"') {
+            text += static_cast<char>(c);
+            c = buffer->snextc();
+        }
+        if (c != END_OF_STREAM) {
+            return text;
+        }
     }
+    input.setstate(std::ios::eofbit);
+    return text;
 }
 
-Node LoadNode(std::istream& input) {
-    char c;
-    if (!(input >> c)) {
-        throw ParsingError("Unexpected EOF"s);
-    }
-    switch (c) {
-        case '[':
-            return LoadArray(input);
-        case '{':
-            return LoadDict(input);
-        case '"':
-            return LoadString(input);
-        case 't':
-            // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-            // подсказкой компилятору и человеку, что здесь программист явно задумывал
-            // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-            // написать break, return или throw.
-            // В данном случае, встретив t или f, переходим к попытке парсинга
-            // литералов true либо false
-            [[fallthrough]];
-        case 'f':
-            input.putback(c);
-            return LoadBool(input);
-        case 'n':
-            input.putback(c);
-            return LoadNull(input);
-        default:
-            input.putback(c);
-            return LoadNumber(input);
+// Вывод копится в большом буфере и сбрасывается в поток крупными блоками,
+// вместо посимвольных вызовов out.put()
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& out)
+        : out_(out) {
+        buffer_.reserve(FLUSH_THRESHOLD + FLUSH_THRESHOLD / 4);
+    }
+
+    void Put(char c) {
+        buffer_.push_back(c);
+        FlushIfFull();
+    }
+
+    void Write(std::string_view text) {
+        buffer_.append(text);
+        FlushIfFull();
+    }
+
+    void Fill(size_t count, char c) {
+        buffer_.append(count, c);
+        FlushIfFull();
+    }
+
+    template <typename Number, typename... Format>
+    void WriteNumber(Number value, Format... format) {
+        char chars[64];
+        const auto result = std::to_chars(chars, chars + sizeof(chars), value, format...);
+        Write({chars, static_cast<size_t>(result.ptr - chars)});
     }
-}
+
+    void Flush() {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+
+private:
+    static constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+    void FlushIfFull() {
+        if (buffer_.size() >= FLUSH_THRESHOLD) {
+            Flush();
+        }
+    }
+
+    std::ostream& out_;
+    std::string buffer_;
+};
 
 struct PrintContext {
-    std::ostream& out;
+    OutputBuffer& out;
+    PrintMode mode = PrintMode::PRETTY;
     int indent_step = 4;
     int indent = 0;
 
+    bool IsCompact() const {
+        return mode == PrintMode::COMPACT;
+    }
+
+    // В компактном режиме переводы строк и отступы не выводятся
+    void PrintNewLine() const {
+        if (!IsCompact()) {
+            out.Put('\n');
+        }
+    }
+
     void PrintIndent() const {
-        for (int i = 0; i < indent; ++i) {
-            out.put(' ');
+        if (!IsCompact()) {
+            out.Fill(static_cast<size_t>(indent), ' ');
         }
     }
 
     PrintContext Indented() const {
-        return {out, indent_step, indent_step + indent};
+        return {out, mode, indent_step, indent_step + indent};
     }
 };
 
 void PrintNode(const Node& value, const PrintContext& ctx);
 
-template <typename Value>
-void PrintValue(const Value& value, const PrintContext& ctx) {
-    ctx.out << value;
+void PrintValue(int value, const PrintContext& ctx) {
+    ctx.out.WriteNumber(value);
 }
 
-void PrintString(const std::string& value, std::ostream& out) {
-    out.put('"');
-    for (const char c : value) {
-        switch (c) {
+void PrintValue(double value, const PrintContext& ctx) {
+    if (ctx.IsCompact()) {
+        // Кратчайшее представление, которое читается обратно в то же число
+        ctx.out.WriteNumber(value);
+    } else {
+        // То же, что выводит ostream << double: %g с шестью значащими цифрами
+        ctx.out.WriteNumber(value, std::chars_format::general, 6);
+    }
+}
+
+// Передаёт в write экранированный value: участки без спецсимволов — целиком
+template <typename Write>
+void WriteEscaped(std::string_view value, Write write) {
+    size_t run_begin = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        std::string_view escaped;
+        switch (value[i]) {
             case '\r':
-                out << "\\r"sv;
+                escaped = "\\r"sv;
                 break;
             case '\n':
-                out << "\\n"sv;
+                escaped = "\\n"sv;
                 break;
             case '\t':
-                out << "\\t"sv;
+                escaped = "\\t"sv;
                 break;
             case '"':
                 // Символы " и \ выводятся как \" или \\, соответственно
-                [[fallthrough]];
+                escaped = "\\\""sv;
+                break;
             case '\\':
-                out.put('\\');
-                [[fallthrough]];
-            default:
-                out.put(c);
+                escaped = "\\\\"sv;
                 break;
+            default:
+                continue;
         }
+        write(value.substr(run_begin, i - run_begin));
+        write(escaped);
+        run_begin = i + 1;
     }
-    out.put('"');
+    write(value.substr(run_begin));
+}
+
+void PrintString(std::string_view value, OutputBuffer& out) {
+    out.Put('"');
+    WriteEscaped(value, [&out](std::string_view part) {
+        out.Write(part);
+    });
+    out.Put('"');
 }
 
-template <>
-void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
+void PrintValue(const std::string& value, const PrintContext& ctx) {
     PrintString(value, ctx.out);
 }
 
-template <>
-void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
-    ctx.out << "null"sv;
+void PrintValue(const EscapedString& value, const PrintContext& ctx) {
+    ctx.out.Put('"');
+    if (value.text) {
+        ctx.out.Write(*value.text);
+    }
+    ctx.out.Put('"');
+}
+
+void PrintValue(std::nullptr_t, const PrintContext& ctx) {
+    ctx.out.Write("null"sv);
 }
 
-// В специализации шаблона PrintValue для типа bool параметр value передаётся
-// по константной ссылке, как и в основном шаблоне.
-// В качестве альтернативы можно использовать перегрузку:
-// void PrintValue(bool value, const PrintContext& ctx);
-template <>
-void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
-    ctx.out << (value ? "true"sv : "false"sv);
+void PrintValue(bool value, const PrintContext& ctx) {
+    ctx.out.Write(value ? "true"sv : "false"sv);
 }
 
-template <>
-void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "[\n"sv;
+void PrintValue(const Array& nodes, const PrintContext& ctx) {
+    OutputBuffer& out = ctx.out;
+    out.Put('[');
+    ctx.PrintNewLine();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const Node& node : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.Put(',');
+            ctx.PrintNewLine();
         }
         inner_ctx.PrintIndent();
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintNewLine();
     ctx.PrintIndent();
-    out.put(']');
+    out.Put(']');
 }
 
-template <>
-void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
-    std::ostream& out = ctx.out;
-    out << "{\n"sv;
+void PrintValue(const Dict& nodes, const PrintContext& ctx) {
+    OutputBuffer& out = ctx.out;
+    out.Put('{');
+    ctx.PrintNewLine();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const auto& [key, node] : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.Put(',');
+            ctx.PrintNewLine();
         }
         inner_ctx.PrintIndent();
-        PrintString(key, ctx.out);
-        out << ": "sv;
+        PrintString(key, out);
+        out.Write(ctx.IsCompact() ? ":"sv : ": "sv);
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintNewLine();
     ctx.PrintIndent();
-    out.put('}');
+    out.Put('}');
 }
 
 void PrintNode(const Node& node, const PrintContext& ctx) {
@@ -343,12 +637,28 @@ void PrintNode(const Node& node, const PrintContext& ctx) {
 
 }  // namespace
 
+std::string EscapeString(std::string_view value) {
+    std::string result;
+    result.reserve(value.size() + value.size() / 8);
+    WriteEscaped(value, [&result](std::string_view part) {
+        result += part;
+    });
+    return result;
+}
+
+Document Load(std::string_view text) {
+    const std::vector<uint32_t> index = BuildStructuralIndex(text);
+    return Document{Parser(text, index).ParseNode()};
+}
+
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    return Load(ReadValue(input));
 }
 
-void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), PrintContext{output});
+void Print(const Document& doc, std::ostream& output, PrintMode mode) {
+    OutputBuffer buffer(output);
+    PrintNode(doc.GetRoot(), PrintContext{buffer, mode});
+    buffer.Flush();
 }
 
-}  // namespace json
\ No newline at end of file
+}  // namespace json
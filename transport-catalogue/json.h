@@ -1,24 +1,86 @@
 #pragma once
 
+#include <algorithm>
+#include <iterator>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
 namespace json {
 
 class Node;
-using Dict = std::map<std::string, Node>;
 using Array = std::vector<Node>;
 
+// Словарь на отсортированном векторе пар. Объекты в наших документах маленькие
+// (единицы-десятки ключей), поэтому двоичный поиск по непрерывному массиву
+// обходится дешевле std::map и не требует отдельной аллокации на каждый ключ.
+// Интерфейс повторяет используемое подмножество std::map, порядок обхода — по ключу.
+class Dict {
+public:
+    using value_type = std::pair<std::string, Node>;
+    using Storage = std::vector<value_type>;
+    using iterator = Storage::iterator;
+    using const_iterator = Storage::const_iterator;
+
+    Dict() = default;
+    // Принимает элементы в произвольном порядке. Из повторяющихся ключей
+    // остаётся последний, как при записи через operator[]
+    explicit Dict(Storage items);
+
+    iterator begin() { return items_.begin(); }
+    iterator end() { return items_.end(); }
+    const_iterator begin() const { return items_.begin(); }
+    const_iterator end() const { return items_.end(); }
+
+    size_t size() const { return items_.size(); }
+    bool empty() const { return items_.empty(); }
+    void reserve(size_t capacity) { items_.reserve(capacity); }
+
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    size_t count(std::string_view key) const;
+
+    Node& at(std::string_view key);
+    const Node& at(std::string_view key) const;
+    Node& operator[](std::string_view key);
+
+    std::pair<iterator, bool> emplace(std::string key, Node value);
+
+    bool operator==(const Dict& rhs) const;
+
+private:
+    Storage items_;
+};
+
+// Строка, уже экранированная по правилам JSON (без кавычек). Выводится как есть,
+// поэтому большой текст, который повторяется в ответах, экранируется один раз
+// и не копируется: узлы делят один буфер. Используется только для вывода.
+// Без буфера (EscapedString{}) — пустая строка
+struct EscapedString {
+    std::shared_ptr<const std::string> text;
+
+    // Сравнивается текст; пустой указатель равен только пустому указателю
+
+    bool operator==(const EscapedString& rhs) const {
+        return text == rhs.text || (text && rhs.text && *text == *rhs.text);
+    }
+};
+
+// Экранирует value для вывода внутри JSON-строки
+std::string EscapeString(std::string_view value);
+
 class ParsingError : public std::runtime_error {
 public:
     using runtime_error::runtime_error;
 };
 
 class Node final
-    : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string> {
+    : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string, EscapedString> {
 public:
     using variant::variant;
     using Value = variant;
@@ -117,6 +179,84 @@ inline bool operator!=(const Node& lhs, const Node& rhs) {
     return !(lhs == rhs);
 }
 
+inline Dict::Dict(Storage items)
+    : items_(std::move(items)) {
+    auto by_key = [](const value_type& lhs, const value_type& rhs) {
+        return lhs.first < rhs.first;
+    };
+    if (!std::is_sorted(items_.begin(), items_.end(), by_key)) {
+        std::stable_sort(items_.begin(), items_.end(), by_key);
+    }
+    // После устойчивой сортировки повторы стоят подряд в исходном порядке
+    if (items_.empty()) {
+        return;
+    }
+    auto last = items_.begin();
+    for (auto it = std::next(items_.begin()); it != items_.end(); ++it) {
+        if (it->first != last->first) {
+            ++last;
+        }
+        if (last != it) {
+            *last = std::move(*it);
+        }
+    }
+    items_.erase(std::next(last), items_.end());
+}
+
+inline Dict::iterator Dict::find(std::string_view key) {
+    auto it = std::lower_bound(items_.begin(), items_.end(), key,
+        [](const value_type& item, std::string_view k) { return item.first < k; });
+    return it != items_.end() && it->first == key ? it : items_.end();
+}
+
+inline Dict::const_iterator Dict::find(std::string_view key) const {
+    auto it = std::lower_bound(items_.begin(), items_.end(), key,
+        [](const value_type& item, std::string_view k) { return item.first < k; });
+    return it != items_.end() && it->first == key ? it : items_.end();
+}
+
+inline size_t Dict::count(std::string_view key) const {
+    return find(key) != items_.end() ? 1 : 0;
+}
+
+inline Node& Dict::at(std::string_view key) {
+    using namespace std::literals;
+    if (auto it = find(key); it != items_.end()) {
+        return it->second;
+    }
+    throw std::out_of_range("Key '"s + std::string(key) + "' is not found"s);
+}
+
+inline const Node& Dict::at(std::string_view key) const {
+    using namespace std::literals;
+    if (auto it = find(key); it != items_.end()) {
+        return it->second;
+    }
+    throw std::out_of_range("Key '"s + std::string(key) + "' is not found"s);
+}
+
+inline Node& Dict::operator[](std::string_view key) {
+    auto it = std::lower_bound(items_.begin(), items_.end(), key,
+        [](const value_type& item, std::string_view k) { return item.first < k; });
+    if (it == items_.end() || it->first != key) {
+        it = items_.emplace(it, std::string(key), Node{});
+    }
+    return it->second;
+}
+
+inline std::pair<Dict::iterator, bool> Dict::emplace(std::string key, Node value) {
+    auto it = std::lower_bound(items_.begin(), items_.end(), key,
+        [](const value_type& item, const std::string& k) { return item.first < k; });
+    if (it != items_.end() && it->first == key) {
+        return {it, false};
+    }
+    return {items_.emplace(it, std::move(key), std::move(value)), true};
+}
+
+inline bool Dict::operator==(const Dict& rhs) const {
+    return items_ == rhs.items_;
+}
+
 class Document {
 public:
     explicit Document(Node root)
@@ -139,8 +279,18 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
     return !(lhs == rhs);
 }
 
+// PRETTY — многострочный вывод с отступом в четыре пробела,
+// COMPACT — без пробелов и переводов строк, для машинных потребителей
+enum class PrintMode {
+    PRETTY,
+    COMPACT,
+};
+
+// Документ разбирается целиком из буфера. Из потока читается ровно одно значение,
+// остаток потока не трогается
+Document Load(std::string_view text);
 Document Load(std::istream& input);
 
-void Print(const Document& doc, std::ostream& output);
+void Print(const Document& doc, std::ostream& output, PrintMode mode = PrintMode::PRETTY);
 
 }  // namespace json
\ No newline at end of file
@@ -152,6 +152,16 @@ namespace json {
         node_stack_.pop();
     }
 
+    Builder& Builder::Value(Node::Value value) {
+        AddValue(std::move(value));
+        return *this;
+    }
+
+    Builder& Builder::Key(std::string key) {
+        AddKey(std::move(key));
+        return *this;
+    }
+
     Builder& Builder::EndDict() {
         EndDictImpl();
         return *this;
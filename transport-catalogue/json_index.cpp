@@ -0,0 +1,238 @@
+#include "json_index.h"
+#include "json.h"
+
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#if !defined(JSON_INDEX_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#include <immintrin.h>
+#define JSON_INDEX_SSE2
+#if defined(__GNUC__)
+#define JSON_INDEX_AVX2
+#endif
+#endif
+
+namespace json {
+
+namespace {
+using namespace std::literals;
+
+constexpr size_t BLOCK_SIZE = 64;
+
+// Классы символов одного 64-байтного блока: бит i соответствует байту i
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t op = 0;  // { } [ ] : ,
+    uint64_t whitespace = 0;
+};
+
+using Classifier = BlockMasks (*)(const char* block);
+
+[[maybe_unused]] BlockMasks ClassifyScalar(const char* block) {
+    BlockMasks masks;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        const uint64_t bit = uint64_t{1} << i;
+        switch (block[i]) {
+            case '"':
+                masks.quote |= bit;
+                break;
+            case '\\':
+                masks.backslash |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                masks.op |= bit;
+                break;
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                masks.whitespace |= bit;
+                break;
+            default:
+                break;
+        }
+    }
+    return masks;
+}
+
+#ifdef JSON_INDEX_SSE2
+// '[' и ']' отличаются от '{' и '}' только битом 0x20, поэтому скобки
+// распознаются двумя сравнениями после OR с 0x20
+BlockMasks ClassifySse2(const char* block) {
+    BlockMasks masks;
+    for (size_t offset = 0; offset < BLOCK_SIZE; offset += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + offset));
+        const __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+
+        const __m128i quote = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'));
+        const __m128i backslash = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'));
+        const __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                         _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')),
+                         _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+        const __m128i whitespace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                         _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')),
+                         _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+
+        masks.quote |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(quote))} << offset;
+        masks.backslash |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(backslash))} << offset;
+        masks.op |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(op))} << offset;
+        masks.whitespace |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(whitespace))} << offset;
+    }
+    return masks;
+}
+#endif
+
+#ifdef JSON_INDEX_AVX2
+__attribute__((target("avx2")))
+BlockMasks ClassifyAvx2(const char* block) {
+    BlockMasks masks;
+    for (size_t offset = 0; offset < BLOCK_SIZE; offset += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + offset));
+        const __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+
+        const __m256i quote = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'));
+        const __m256i backslash = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'));
+        const __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                            _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')),
+                            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+        const __m256i whitespace = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')),
+                            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+
+        masks.quote |= uint64_t{static_cast<uint32_t>(_mm256_movemask_epi8(quote))} << offset;
+        masks.backslash |= uint64_t{static_cast<uint32_t>(_mm256_movemask_epi8(backslash))} << offset;
+        masks.op |= uint64_t{static_cast<uint32_t>(_mm256_movemask_epi8(op))} << offset;
+        masks.whitespace |= uint64_t{static_cast<uint32_t>(_mm256_movemask_epi8(whitespace))} << offset;
+    }
+    return masks;
+}
+#endif
+
+Classifier ChooseClassifier() {
+#ifdef JSON_INDEX_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return ClassifyAvx2;
+    }
+#endif
+#ifdef JSON_INDEX_SSE2
+    return ClassifySse2;
+#else
+    return ClassifyScalar;
+#endif
+}
+
+// Бит i результата — XOR битов 0..i исходного значения
+uint64_t PrefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Переводит маски классов в позиции структурных символов.
+// Между блоками переносятся три состояния: экранирован ли первый байт
+// следующего блока, закончился ли блок внутри строки и внутри литерала
+class StructuralScanner {
+public:
+    explicit StructuralScanner(std::vector<uint32_t>& index)
+        : index_(index) {
+    }
+
+    void ScanBlock(const BlockMasks& masks, uint32_t block_offset) {
+        const uint64_t escaped = FindEscaped(masks.backslash);
+        const uint64_t quotes = masks.quote & ~escaped;
+
+        // Открывающая кавычка и содержимое строки входят в маску, закрывающая — нет
+        const uint64_t in_string = PrefixXor(quotes) ^ prev_in_string_;
+        prev_in_string_ = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+        // Литерал или число начинается там, где перед ним не было другого символа литерала
+        const uint64_t scalar = ~(masks.op | masks.whitespace | quotes);
+        const uint64_t scalar_starts = scalar & ~((scalar << 1) | prev_scalar_);
+        prev_scalar_ = scalar >> 63;
+
+        for (uint64_t structurals = ((masks.op | scalar_starts) & ~in_string) | quotes;
+             structurals != 0;
+             structurals &= structurals - 1)
+        {
+            index_.push_back(block_offset + static_cast<uint32_t>(std::countr_zero(structurals)));
+        }
+    }
+
+    bool IsInsideString() const {
+        return prev_in_string_ != 0;
+    }
+
+private:
+    // Символы, перед которыми стоит неэкранированный обратный слеш.
+    // Слеши встречаются редко, поэтому обходим их по одному
+    uint64_t FindEscaped(uint64_t backslash) {
+        uint64_t escaped = prev_escaped_;
+        prev_escaped_ = 0;
+        for (backslash &= ~escaped; backslash != 0; backslash &= ~escaped) {
+            const int position = std::countr_zero(backslash);
+            if (position == 63) {
+                prev_escaped_ = 1;
+            } else {
+                escaped |= uint64_t{1} << (position + 1);
+            }
+            backslash &= backslash - 1;
+        }
+        return escaped;
+    }
+
+    std::vector<uint32_t>& index_;
+    uint64_t prev_escaped_ = 0;
+    uint64_t prev_in_string_ = 0;
+    uint64_t prev_scalar_ = 0;
+};
+
+}  // namespace
+
+std::vector<uint32_t> BuildStructuralIndex(std::string_view text) {
+    if (text.size() > std::numeric_limits<uint32_t>::max()) {
+        throw ParsingError("Document is too large"s);
+    }
+    static const Classifier classify = ChooseClassifier();
+
+    std::vector<uint32_t> index;
+    index.reserve(text.size() / 8);
+    StructuralScanner scanner(index);
+
+    size_t offset = 0;
+    for (; offset + BLOCK_SIZE <= text.size(); offset += BLOCK_SIZE) {
+        scanner.ScanBlock(classify(text.data() + offset), static_cast<uint32_t>(offset));
+    }
+    if (offset < text.size()) {
+        // Хвост дополняется пробелами, которые в индекс не попадают
+        char tail[BLOCK_SIZE];
+        std::memset(tail, ' ', BLOCK_SIZE);
+        std::memcpy(tail, text.data() + offset, text.size() - offset);
+        scanner.ScanBlock(classify(tail), static_cast<uint32_t>(offset));
+    }
+
+    if (scanner.IsInsideString()) {
+        throw ParsingError("String parsing error"s);
+    }
+    return index;
+}
+
+}  // namespace json
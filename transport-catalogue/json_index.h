@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace json {
+
+// Первая стадия разбора: позиции всех структурных символов документа.
+// В индекс попадают скобки, двоеточия и запятые вне строк, обе кавычки каждой строки
+// и первый символ каждого литерала или числа. Вторая стадия (json::Load) строит
+// дерево Node, переходя по индексу и не просматривая документ посимвольно.
+// Символы классифицируются блоками по 64 байта: AVX2 или SSE2, если процессор
+// их поддерживает, иначе скалярно. Результат от способа не зависит.
+// Бросает ParsingError, если документ заканчивается внутри строки.
+std::vector<uint32_t> BuildStructuralIndex(std::string_view text);
+
+}  // namespace json
@@ -1,68 +1,176 @@
 #include "json_reader.h"
 #include "map_renderer.h"
+#include "trace.h"
+#include <chrono>
+#include <stdexcept>
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <sstream>
+#include <iterator>
+#include <unordered_set>
 
 using namespace transport_catalogue;
 
+namespace {
+
+// На этом уровне тайл уже в миллион раз крупнее исходной карты
+constexpr int MAX_TILE_ZOOM = 20;
+
+// Пересадок в RouteOptions: по умолчанию и не больше чем. Каждая пересадка — ещё
+// один раунд поиска по всем затронутым направлениям
+constexpr int DEFAULT_ROUTE_TRANSFERS = 3;
+constexpr int MAX_ROUTE_TRANSFERS = 8;
+
+// Больше вариантов в одном ответе Route не ищется
+constexpr int MAX_ROUTE_ALTERNATIVES = 10;
+
+// Поле items ответа Route: ожидания и поездки маршрута
+void WriteRouteItems(json::Builder& builder, const transport::TransportRouter::RouteInfo& route_info) {
+    builder.Key("items").StartArray();
+    for (const auto& item : route_info.items) {
+        if (item.type == transport::TransportRouter::RouteItem::Type::WAIT) {
+            builder.StartDict()
+                .Key("type").Value("Wait")
+                .Key("stop_name").Value(item.stop_name)
+                .Key("time").Value(item.time)
+            .EndDict();
+        } else {
+            builder.StartDict()
+                .Key("type").Value("Bus")
+                .Key("bus").Value(item.bus_name)
+                .Key("span_count").Value(static_cast<int>(item.span_count))
+                .Key("time").Value(item.time)
+            .EndDict();
+        }
+    }
+    builder.EndArray();
+}
+
+}  // namespace
+
 void JsonReader::ParsingBaseRequests(const json::Array& base_requests) {
-    std::vector<const json::Dict*> stops_with_distances;
-    std::vector<const json::Dict*> buses;
+    TRACE_SCOPE("JsonReader::ParsingBaseRequests");
+    ApplyBaseRequests(ParseBaseRequests(base_requests));
+}
+
+void JsonReader::UpdateBase(const json::Array& base_requests) {
+    // Разбор не трогает каталог: запрос с ошибкой в любом элементе отклоняется целиком
+    const BaseRequests base = ParseBaseRequests(base_requests);
 
+    // Каталог не умеет заменять объекты: старый остался бы в списке автобусов
+    // остановки и в графе, поэтому уже известные имена не принимаются
+    std::unordered_set<std::string_view> stop_names;
+    for (const auto& stop : base.stops) {
+        if (catalogue_.FindStop(stop.name) || !stop_names.insert(stop.name).second) {
+            throw std::invalid_argument("stop already exists: " + std::string(stop.name));
+        }
+    }
+    std::unordered_set<std::string_view> bus_names;
+    for (const auto& bus : base.buses) {
+        if (catalogue_.FindBus(bus.name) || !bus_names.insert(bus.name).second) {
+            throw std::invalid_argument("bus already exists: " + std::string(bus.name));
+        }
+    }
+
+    try {
+        ApplyBaseRequests(base);
+        router_.BuildGraph();
+    } catch (const std::exception& e) {
+        // Каталог уже изменён: граф должен соответствовать ему, а не прежней базе.
+        // Если и это не удалось, остаётся прежний граф, о чём говорит ошибка
+        try {
+            router_.BuildGraph();
+        } catch (const std::exception&) {
+        }
+        throw std::runtime_error(std::string("update partially applied, routes may be stale: ") + e.what());
+    }
+}
+
+JsonReader::BaseRequests JsonReader::ParseBaseRequests(const json::Array& base_requests) {
+    BaseRequests base;
+    base.stops.reserve(base_requests.size());
     for (const auto& node : base_requests) {
         const auto& request = node.AsDict();
         const std::string& type = request.at("type").AsString();
 
         if (type == "Stop") {
-            ProcessStop(request);
-            if (request.count("road_distances")) {
-                stops_with_distances.push_back(&request);
-            }
+            base.stops.push_back(ParseStop(request));
         } else if (type == "Bus") {
-            buses.push_back(&request);
+            base.buses.push_back(ParseBus(request));
         }
     }
+    return base;
+}
 
-    for (const auto* request : stops_with_distances) {
-        ProcessRoadDistances(*request);
+void JsonReader::ApplyBaseRequests(const BaseRequests& base) {
+    for (const auto& stop : base.stops) {
+        catalogue_.AddStop(stop.name, stop.coordinates);
     }
 
-    for (const auto* request : buses) {
-        ProcessBus(*request);
+    // Расстояния — после всех остановок: они могут ссылаться на следующие
+    for (const auto& stop : base.stops) {
+        const auto* from_stop = catalogue_.FindStop(stop.name);
+        for (const auto& [name, distance] : stop.road_distances) {
+            if (const auto* to_stop = catalogue_.FindStop(name)) {
+                catalogue_.SetDistance(from_stop, to_stop, distance);
+            }
+        }
     }
-}
 
-void JsonReader::ProcessStop(const json::Dict& request) {
-    catalogue_.AddStop(
-        request.at("name").AsString(),
-        { request.at("latitude").AsDouble(),
-          request.at("longitude").AsDouble() }
-    );
+    for (const auto& bus : base.buses) {
+        catalogue_.AddBus(bus.name, bus.stops, bus.is_roundtrip);
+        if (!bus.departures.empty()) {
+            catalogue_.SetBusDepartures(bus.name, bus.departures);
+        }
+    }
 }
 
-void JsonReader::ProcessRoadDistances(const json::Dict& request) {
-    const auto* from_stop = catalogue_.FindStop(request.at("name").AsString());
-    for (const auto& kv : request.at("road_distances").AsDict()) {
-        const auto* to_stop = catalogue_.FindStop(kv.first);
-        if (from_stop && to_stop) {
-            catalogue_.SetDistance(from_stop, to_stop, kv.second.AsInt());
+JsonReader::StopRequest JsonReader::ParseStop(const json::Dict& request) {
+    StopRequest stop;
+    stop.name = request.at("name").AsString();
+    stop.coordinates = {request.at("latitude").AsDouble(), request.at("longitude").AsDouble()};
+    if (const auto it = request.find("road_distances"); it != request.end()) {
+        const auto& distances = it->second.AsDict();
+        stop.road_distances.reserve(distances.size());
+        for (const auto& [name, distance] : distances) {
+            stop.road_distances.emplace_back(name, distance.AsInt());
         }
     }
+    return stop;
 }
 
-void JsonReader::ProcessBus(const json::Dict& request) {
-    std::vector<std::string_view> stops_view;
-    for (const auto& stop_node : request.at("stops").AsArray()) {
-        stops_view.push_back(stop_node.AsString());
+JsonReader::BusRequest JsonReader::ParseBus(const json::Dict& request) {
+    BusRequest bus;
+    bus.name = request.at("name").AsString();
+    const auto& stops = request.at("stops").AsArray();
+    bus.stops.reserve(stops.size());
+    for (const auto& stop_node : stops) {
+        bus.stops.push_back(stop_node.AsString());
     }
+    bus.is_roundtrip = request.at("is_roundtrip").AsBool();
 
-    bool is_roundtrip = request.at("is_roundtrip").AsBool();
-    catalogue_.AddBus(request.at("name").AsString(), stops_view, is_roundtrip);
+    // Расписание: явный список "departures" или "headway" с интервалом движения
+    if (const auto it = request.find("departures"); it != request.end()) {
+        for (const auto& departure : it->second.AsArray()) {
+            bus.departures.push_back(departure.AsDouble());
+        }
+    }
+    if (const auto it = request.find("headway"); it != request.end()) {
+        const auto& headway = it->second.AsDict();
+        const double first = headway.at("first_departure").AsDouble();
+        const double last = headway.at("last_departure").AsDouble();
+        const double interval = headway.at("interval").AsDouble();
+        if (interval > 0) {
+            for (int trip = 0; first + trip * interval <= last; ++trip) {
+                bus.departures.push_back(first + trip * interval);
+            }
+        }
+    }
+    return bus;
 }
 
 void JsonReader::ParsingRenderSettings(const json::Dict& reader_settings) {
+    TRACE_SCOPE("JsonReader::ParsingRenderSettings");
     RenderSettings settings;
     settings.width                = reader_settings.at("width").AsDouble();
     settings.height               = reader_settings.at("height").AsDouble();
@@ -85,7 +193,39 @@ void JsonReader::ParsingRenderSettings(const json::Dict& reader_settings) {
         settings.color_palette.push_back(ParseColor(color_node));
     }
 
+    if (const auto it = reader_settings.find("simplify_tolerance"); it != reader_settings.end()) {
+        settings.simplify_tolerance = it->second.AsDouble();
+    }
+    if (const auto it = reader_settings.find("style_classes"); it != reader_settings.end()) {
+        settings.style_classes = it->second.AsBool();
+    }
+    if (const auto it = reader_settings.find("coordinate_precision"); it != reader_settings.end()) {
+        settings.coordinate_precision = it->second.AsInt();
+    }
+
     render_settings_ = std::move(settings);
+    // Хэш отсеивает изменившиеся настройки сразу, совпадение проверяется по значениям
+    if (map_renderer_ && (map_renderer_->GetSettingsHash() != HashRenderSettings(render_settings_)
+                          || map_renderer_->GetSettings() != render_settings_)) {
+        map_renderer_.reset();
+        escaped_map_.reset();
+    }
+}
+
+const MapRenderer& JsonReader::GetMapRenderer() const {
+    if (!map_renderer_) {
+        map_renderer_ = std::make_unique<MapRenderer>(catalogue_, render_settings_);
+    }
+    return *map_renderer_;
+}
+
+const json::EscapedString& JsonReader::GetEscapedMap() const {
+    const uint64_t version = catalogue_.GetVersion();
+    if (!escaped_map_ || escaped_map_->first != version) {
+        auto text = std::make_shared<const std::string>(json::EscapeString(GetMapRenderer().GetMapSvg()));
+        escaped_map_.emplace(version, json::EscapedString{std::move(text)});
+    }
+    return escaped_map_->second;
 }
 
 svg::Color JsonReader::ParseColor(const json::Node& node) {
@@ -113,115 +253,263 @@ svg::Color JsonReader::ParseColor(const json::Node& node) {
     return svg::NoneColor;
 }
 
-json::Document JsonReader::ParsingStatRequests(const json::Array& stat_requests) const {
+json::Document JsonReader::ParsingStatRequests(const json::Array& stat_requests,
+                                               metrics::RequestLatencies* latencies) const {
+    TRACE_SCOPE("JsonReader::ParsingStatRequests");
     json::Builder builder;
     auto arr_ctx = builder.StartArray();
 
+    if (!latencies) {
+        for (const auto& node : stat_requests) {
+            json::Node response = ProcessStatRequest(node.AsDict());
+            arr_ctx.Value(std::move(response.GetValue()));
+        }
+        return json::Document(arr_ctx.EndArray().Build());
+    }
+
+    using Clock = std::chrono::steady_clock;
     for (const auto& node : stat_requests) {
         const auto& request = node.AsDict();
-        int request_id = request.at("id").AsInt();
-        const std::string& type = request.at("type").AsString();
+        const auto start = Clock::now();
+        json::Node response = ProcessStatRequest(request);
+        arr_ctx.Value(std::move(response.GetValue()));
+        latencies->Record(request.at("type").AsString(), request.at("id").AsInt(), Clock::now() - start);
+    }
+
+    return json::Document(arr_ctx.EndArray().Build());
+}
 
-        if (type == "Bus") {
-            auto info_opt = catalogue_.GetBusInfo(request.at("name").AsString());
-            if (info_opt) {
-                const auto& info = *info_opt;
-                arr_ctx.StartDict()
+json::Node JsonReader::ProcessStatRequest(const json::Dict& request) const {
+    json::Builder builder;
+    int request_id = request.at("id").AsInt();
+    const std::string& type = request.at("type").AsString();
+    TRACE_SCOPE_ARG(type, "id", request_id);
+
+    if (type == "Bus") {
+        auto info_opt = catalogue_.GetBusInfo(request.at("name").AsString());
+        if (info_opt) {
+            const auto& info = *info_opt;
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("stop_count").Value(static_cast<int>(info.stop_count))
+                .Key("unique_stop_count").Value(static_cast<int>(info.unique_stop_count))
+                .Key("route_length").Value(info.route_length)
+                .Key("curvature").Value(info.curvature)
+            .EndDict();
+        } else {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("error_message").Value("not found")
+            .EndDict();
+        }
+    } else if (type == "Stop") {
+        const auto* stop = catalogue_.FindStop(request.at("name").AsString());
+        if (!stop) {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("error_message").Value("not found")
+            .EndDict();
+        } else {
+            auto buses = catalogue_.GetBusesByStop(stop->name);
+            std::vector<std::string> bus_names;
+            bus_names.reserve(buses.size());
+            for (const auto* b : buses) {
+                bus_names.push_back(b->name);
+            }
+            std::sort(bus_names.begin(), bus_names.end());
+
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("buses").StartArray();
+
+            for (const auto& name : bus_names) {
+                builder.Value(name);
+            }
+
+            builder.EndArray()
+            .EndDict();
+        }
+    } else if (type == "Map") {
+        // Необязательные tile или bbox ограничивают карту фрагментом
+        const auto tile_it = request.find("tile");
+        const auto bbox_it = request.find("bbox");
+        if (tile_it != request.end()) {
+            const auto& tile_dict = tile_it->second.AsDict();
+            const MapTile tile{tile_dict.at("z").AsInt(), tile_dict.at("x").AsInt(), tile_dict.at("y").AsInt()};
+            const bool valid = tile.zoom >= 0 && tile.zoom <= MAX_TILE_ZOOM
+                && tile.x >= 0 && tile.x < (1 << tile.zoom)
+                && tile.y >= 0 && tile.y < (1 << tile.zoom);
+            if (valid) {
+                builder.StartDict()
                     .Key("request_id").Value(request_id)
-                    .Key("stop_count").Value(static_cast<int>(info.stop_count))
-                    .Key("unique_stop_count").Value(static_cast<int>(info.unique_stop_count))
-                    .Key("route_length").Value(info.route_length)
-                    .Key("curvature").Value(info.curvature)
+                    .Key("map").Value(GetMapRenderer().RenderTile(tile))
                 .EndDict();
             } else {
-                arr_ctx.StartDict()
+                builder.StartDict()
                     .Key("request_id").Value(request_id)
-                    .Key("error_message").Value("not found")
+                    .Key("error_message").Value("invalid tile")
                 .EndDict();
             }
-        } else if (type == "Stop") {
-            const auto* stop = catalogue_.FindStop(request.at("name").AsString());
-            if (!stop) {
-                arr_ctx.StartDict()
-                    .Key("request_id").Value(request_id)
-                    .Key("error_message").Value("not found")
-                .EndDict();
-            } else {
-                auto buses = catalogue_.GetBusesByStop(stop->name);
-                std::vector<std::string> bus_names;
-                bus_names.reserve(buses.size());
-                for (const auto* b : buses) {
-                    bus_names.push_back(b->name);
+        } else if (bbox_it != request.end()) {
+            const auto& bbox_dict = bbox_it->second.AsDict();
+            const GeoBounds bounds{
+                {bbox_dict.at("min_lat").AsDouble(), bbox_dict.at("min_lng").AsDouble()},
+                {bbox_dict.at("max_lat").AsDouble(), bbox_dict.at("max_lng").AsDouble()}
+            };
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("map").Value(GetMapRenderer().RenderBounds(bounds))
+            .EndDict();
+        } else {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("map").Value(GetEscapedMap())
+            .EndDict();
+        }
+    } else if (type == "Route" || type == "RouteMap") {
+        const std::string& from = request.at("from").AsString();
+        const std::string& to = request.at("to").AsString();
+
+        // С departure_time маршрут строится по расписаниям, с alternatives к лучшему
+        // маршруту добавляются до alternatives заметно отличающихся
+        const auto departure_it = request.find("departure_time");
+        const auto alternatives_it = request.find("alternatives");
+        const bool with_alternatives = alternatives_it != request.end() && departure_it == request.end();
+        std::optional<transport::TransportRouter::RouteInfo> route_info;
+        std::vector<transport::TransportRouter::RouteInfo> alternatives;
+        if (departure_it != request.end()) {
+            route_info = router_.FindRoute(from, to, departure_it->second.AsDouble());
+        } else if (with_alternatives) {
+            const int count = std::clamp(alternatives_it->second.AsInt(), 0, MAX_ROUTE_ALTERNATIVES);
+            auto routes = router_.FindRoutes(from, to, count + 1);
+            if (!routes.empty()) {
+                route_info = std::move(routes.front());
+                alternatives.assign(std::make_move_iterator(routes.begin() + 1),
+                                    std::make_move_iterator(routes.end()));
+            }
+        } else {
+            route_info = router_.FindRoute(from, to);
+        }
+
+        if (route_info) {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("total_time").Value(route_info->total_time);
+            WriteRouteItems(builder, *route_info);
+            if (departure_it != request.end()) {
+                builder.Key("arrival_time").Value(departure_it->second.AsDouble() + route_info->total_time);
+            }
+            if (with_alternatives) {
+                builder.Key("alternatives").StartArray();
+                for (const auto& alternative : alternatives) {
+                    builder.StartDict()
+                        .Key("total_time").Value(alternative.total_time);
+                    WriteRouteItems(builder, alternative);
+                    builder.EndDict();
                 }
-                std::sort(bus_names.begin(), bus_names.end());
+                builder.EndArray();
+            }
 
-                arr_ctx.StartDict()
-                    .Key("request_id").Value(request_id)
-                    .Key("buses").StartArray();
-                
-                for (const auto& name : bus_names) {
-                    arr_ctx.Value(name);
+            // RouteMap: тот же ответ и карта с наложенными поездками
+            if (type == "RouteMap") {
+                std::vector<RouteLeg> legs;
+                for (const auto& item : route_info->items) {
+                    if (item.type == transport::TransportRouter::RouteItem::Type::BUS) {
+                        legs.push_back({item.bus, item.first_stop_index,
+                                        static_cast<size_t>(item.span_count), item.backward});
+                    }
                 }
+                builder.Key("map").Value(GetMapRenderer().RenderRouteMap(legs));
+            }
+            builder.EndDict();
+        } else {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("error_message").Value("not found")
+            .EndDict();
+        }
+    } else if (type == "Isochrone") {
+        // Остановки, до которых из from можно доехать за max_time минут; с departure_time —
+        // по расписаниям, с "map": true в ответ добавляется карта с раскрашенными остановками
+        const std::string& from = request.at("from").AsString();
+        const double max_time = request.at("max_time").AsDouble();
+        const auto departure_it = request.find("departure_time");
+        const auto reachable = departure_it != request.end()
+            ? router_.FindReachableStops(from, max_time, departure_it->second.AsDouble())
+            : router_.FindReachableStops(from, max_time);
 
-                arr_ctx.EndArray()
+        if (!reachable) {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("error_message").Value("not found")
+            .EndDict();
+        } else {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("stops").StartArray();
+            for (const auto& [stop, time] : *reachable) {
+                builder.StartDict()
+                    .Key("stop_name").Value(stop->name)
+                    .Key("time").Value(time)
                 .EndDict();
             }
-        } else if (type == "Map") {
-            svg::Document svg_doc;
-            MapRenderer renderer(catalogue_, render_settings_);
-            renderer.Render(svg_doc);
+            builder.EndArray();
 
-            std::ostringstream svg_stream;
-            svg_doc.Render(svg_stream);
+            const auto map_it = request.find("map");
+            if (map_it != request.end() && map_it->second.AsBool()) {
+                std::vector<IsochroneStop> stops;
+                stops.reserve(reachable->size());
+                for (const auto& [stop, time] : *reachable) {
+                    stops.push_back({stop, time});
+                }
+                builder.Key("map").Value(GetMapRenderer().RenderIsochroneMap(stops, max_time));
+            }
+            builder.EndDict();
+        }
+    } else if (type == "RouteOptions") {
+        const std::string& from = request.at("from").AsString();
+        const std::string& to = request.at("to").AsString();
+        const auto transfers_it = request.find("max_transfers");
+        const int max_transfers = transfers_it != request.end()
+            ? std::clamp(transfers_it->second.AsInt(), 0, MAX_ROUTE_TRANSFERS)
+            : DEFAULT_ROUTE_TRANSFERS;
+
+        const auto departure_it = request.find("departure_time");
+        const auto options = departure_it != request.end()
+            ? router_.FindRouteOptions(from, to, max_transfers, departure_it->second.AsDouble())
+            : router_.FindRouteOptions(from, to, max_transfers);
 
-            arr_ctx.StartDict()
+        if (options.empty()) {
+            builder.StartDict()
                 .Key("request_id").Value(request_id)
-                .Key("map").Value(svg_stream.str())
+                .Key("error_message").Value("not found")
             .EndDict();
-        }  else if (type == "Route") {
-    const std::string& from = request.at("from").AsString();
-    const std::string& to = request.at("to").AsString();
-    
-    auto route_info = router_.FindRoute(from, to);
-    
-    if (route_info) {
-        arr_ctx.StartDict()
-            .Key("request_id").Value(request_id)
-            .Key("total_time").Value(route_info->total_time)
-            .Key("items").StartArray();
-        
-        for (const auto& item : route_info->items) {
-            if (item.type == transport::TransportRouter::RouteItem::Type::WAIT) {
-                arr_ctx.StartDict()
-                    .Key("type").Value("Wait")
-                    .Key("stop_name").Value(item.stop_name)
-                    .Key("time").Value(item.time)
-                .EndDict();
-            } else {
-                arr_ctx.StartDict()
-                    .Key("type").Value("Bus")
-                    .Key("bus").Value(item.bus_name)
-                    .Key("span_count").Value(static_cast<int>(item.span_count))
-                    .Key("time").Value(item.time)
-                .EndDict();
+        } else {
+            builder.StartDict()
+                .Key("request_id").Value(request_id)
+                .Key("options").StartArray();
+            for (const auto& option : options) {
+                const auto rides = std::count_if(option.items.begin(), option.items.end(), [](const auto& item) {
+                    return item.type == transport::TransportRouter::RouteItem::Type::BUS;
+                });
+                builder.StartDict()
+                    .Key("total_time").Value(option.total_time)
+                    .Key("transfers").Value(static_cast<int>(std::max<std::ptrdiff_t>(rides - 1, 0)));
+                WriteRouteItems(builder, option);
+                if (departure_it != request.end()) {
+                    builder.Key("arrival_time").Value(departure_it->second.AsDouble() + option.total_time);
+                }
+                builder.EndDict();
             }
+            builder.EndArray()
+            .EndDict();
         }
-        
-        arr_ctx.EndArray()
-        .EndDict();
     } else {
-        arr_ctx.StartDict()
+        builder.StartDict()
             .Key("request_id").Value(request_id)
-            .Key("error_message").Value("not found")
+            .Key("error_message").Value("unknown request type")
         .EndDict();
     }
-        } else {
-            arr_ctx.StartDict()
-                .Key("request_id").Value(request_id)
-                .Key("error_message").Value("unknown request type")
-            .EndDict();
-        }
-    }
 
-    return json::Document(arr_ctx.EndArray().Build());
-}
\ No newline at end of file
+    return builder.Build();
+}
@@ -6,6 +6,14 @@
 #include "map_renderer.h"
 #include "transport_router.h"
 #include "json_builder.h"
+#include "metrics.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 class JsonReader {
 public:
@@ -14,8 +22,19 @@ public:
         : catalogue_(catalogue), router_(router) {}
 
     void ParsingBaseRequests(const json::Array& base_requests);
+    // Дополняет уже загруженную базу и перестраивает граф маршрутов.
+    // Кэши карты обновляются при следующем запросе Map. Все элементы разбираются
+    // до изменения каталога: запрос без нужных полей или с уже известным именем
+    // остановки или автобуса отклоняется целиком. Если ошибка всё же случилась позже (например, таблица маршрутизатора превысила
+    // лимит памяти), база остаётся частично дополненной, граф перестраивается
+    // по ней, насколько возможно, и бросается std::runtime_error об этом
+    void UpdateBase(const json::Array& base_requests);
     void ParsingRenderSettings(const json::Dict& reader_settings);
-    json::Document ParsingStatRequests(const json::Array& stat_requests) const;
+    // Если передан latencies, время обработки каждого запроса записывается в него
+    json::Document ParsingStatRequests(const json::Array& stat_requests,
+                                       metrics::RequestLatencies* latencies = nullptr) const;
+    // Ответ на один запрос из stat_requests
+    json::Node ProcessStatRequest(const json::Dict& request) const;
     svg::Color ParseColor(const json::Node& node);
     const RenderSettings& GetRenderSettings() const { return render_settings_; }
 
@@ -23,8 +42,37 @@ private:
     transport_catalogue::TransportCatalogue& catalogue_;
     transport::TransportRouter& router_;
     RenderSettings render_settings_;
+    // Живёт между запросами, чтобы повторные запросы Map брали карту из его кэша.
+    // Пересоздаётся, только если изменились настройки рендеринга
+    mutable std::unique_ptr<MapRenderer> map_renderer_;
+    // Карта, уже экранированная для ответа, и версия каталога, для которой она построена.
+    // Сбрасывается вместе с map_renderer_
+    mutable std::optional<std::pair<uint64_t, json::EscapedString>> escaped_map_;
+
+    const MapRenderer& GetMapRenderer() const;
+    const json::EscapedString& GetEscapedMap() const;
+
+    // Элементы base_requests, прочитанные из JSON, но ещё не добавленные в каталог.
+    // Строки ссылаются на разобранный документ
+    struct StopRequest {
+        std::string_view name;
+        Coordinates coordinates;
+        std::vector<std::pair<std::string_view, int>> road_distances;
+    };
+    struct BusRequest {
+        std::string_view name;
+        std::vector<std::string_view> stops;
+        bool is_roundtrip = false;
+        std::vector<double> departures;
+    };
+    struct BaseRequests {
+        std::vector<StopRequest> stops;
+        std::vector<BusRequest> buses;
+    };
 
-    void ProcessStop(const json::Dict& request);              
-    void ProcessRoadDistances(const json::Dict& request);      
-    void ProcessBus(const json::Dict& request);               
+    // Бросает исключение на элементе без нужных полей, не трогая каталог
+    static BaseRequests ParseBaseRequests(const json::Array& base_requests);
+    static StopRequest ParseStop(const json::Dict& request);
+    static BusRequest ParseBus(const json::Dict& request);
+    void ApplyBaseRequests(const BaseRequests& base);
 };
\ No newline at end of file
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Несколько кратчайших путей без повторных вершин (алгоритм Йена). Каждый
+// следующий путь — ответвление от уже найденного: корень совпадает с ним,
+// а остаток ищется заново без рёбер, которыми из этого корня уже уходили.
+//
+// Остаток ищется A* с точной оценкой — весом из таблицы Router до цели.
+// Удаление рёбер только удлиняет пути, так что оценка остаётся допустимой,
+// и поиск почти сразу идёт вдоль ответа. Массивы поиска выделяются один раз
+// и переиспользуются всеми ответвлениями одного запроса.
+//
+// Параллельные рёбра одного веса взаимозаменяемы: пути, которые различаются
+// только ими, считаются одним путём. Иначе каждая такая пара удваивала бы
+// число путей одного веса, и до других путей очередь не доходила бы.
+template <typename Weight>
+class KShortestPaths {
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    KShortestPaths(const DirectedWeightedGraph<Weight>& graph, const Router<Weight>& router);
+
+    // До count путей в порядке неубывания веса, для которых accept(route) вернул
+    // true. Отвергнутые пути тоже порождают ответвления; всего просматривается
+    // не больше max_paths путей
+    template <typename Accept>
+    std::vector<RouteInfo> Find(VertexId from, VertexId to, size_t count, size_t max_paths, Accept accept);
+
+private:
+    // Путь и позиция, с которой он отошёл от породившего его пути: ответвления
+    // раньше неё уже построены от родителя
+    struct Path {
+        RouteInfo route;
+        size_t deviation;
+    };
+
+    // Кратчайший путь из from в to, не заходящий в вершины blocked и не
+    // начинающийся рёбрами removed или взаимозаменяемыми с ними
+    std::optional<RouteInfo> FindSpur(VertexId from, VertexId to, const std::vector<VertexId>& blocked,
+                                      const std::vector<EdgeId>& removed);
+
+    // Рёбра с общими концами и одинаковым весом
+    bool IsInterchangeable(EdgeId lhs, EdgeId rhs) const;
+    // Путь, в котором каждое ребро заменено первым взаимозаменяемым с ним
+    std::vector<EdgeId> GetCanonicalEdges(const std::vector<EdgeId>& edges) const;
+
+    const DirectedWeightedGraph<Weight>& graph_;
+    const Router<Weight>& router_;
+
+    // Метки поколений: значение актуально, только если совпадает с generation_
+    uint32_t generation_ = 0;
+    std::vector<uint32_t> reached_;
+    std::vector<uint32_t> settled_;
+    std::vector<uint32_t> blocked_;
+    std::vector<Weight> distance_;
+    std::vector<EdgeId> prev_edge_;
+};
+
+template <typename Weight>
+KShortestPaths<Weight>::KShortestPaths(const DirectedWeightedGraph<Weight>& graph, const Router<Weight>& router)
+    : graph_(graph)
+    , router_(router)
+    , reached_(graph.GetVertexCount(), 0)
+    , settled_(graph.GetVertexCount(), 0)
+    , blocked_(graph.GetVertexCount(), 0)
+    , distance_(graph.GetVertexCount())
+    , prev_edge_(graph.GetVertexCount()) {
+}
+
+template <typename Weight>
+template <typename Accept>
+std::vector<typename KShortestPaths<Weight>::RouteInfo> KShortestPaths<Weight>::Find(
+        VertexId from, VertexId to, size_t count, size_t max_paths, Accept accept) {
+    TRACE_SCOPE("graph::KShortestPaths");
+    std::vector<RouteInfo> result;
+    auto shortest = router_.BuildRoute(from, to);
+    if (count == 0 || !shortest) {
+        return result;
+    }
+
+    auto heavier = [](const Path& lhs, const Path& rhs) {
+        return lhs.route.weight > rhs.route.weight;
+    };
+    std::priority_queue<Path, std::vector<Path>, decltype(heavier)> candidates(heavier);
+    std::set<std::vector<EdgeId>> seen{GetCanonicalEdges(shortest->edges)};
+    std::vector<Path> found;
+
+    Path next{std::move(*shortest), 0};
+    while (true) {
+        if (accept(next.route)) {
+            result.push_back(next.route);
+            if (result.size() == count) {
+                break;
+            }
+        }
+        found.push_back(std::move(next));
+        if (found.size() >= max_paths) {
+            break;
+        }
+
+        const Path& last = found.back();
+        const auto& edges = last.route.edges;
+        std::vector<VertexId> root_vertices;
+        std::vector<EdgeId> removed;
+        Weight root_weight{};
+        VertexId spur = from;
+        for (size_t i = 0; i < edges.size(); ++i) {
+            if (i >= last.deviation) {
+                // Из этого корня уже уходили рёбрами всех найденных путей с тем же началом
+                removed.clear();
+                for (const Path& path : found) {
+                    const auto& other = path.route.edges;
+                    if (other.size() > i && std::equal(edges.begin(), edges.begin() + i, other.begin(),
+                                                       [this](EdgeId lhs, EdgeId rhs) {
+                                                           return IsInterchangeable(lhs, rhs);
+                                                       })) {
+                        removed.push_back(other[i]);
+                    }
+                }
+                if (auto spur_route = FindSpur(spur, to, root_vertices, removed)) {
+                    std::vector<EdgeId> candidate(edges.begin(), edges.begin() + i);
+                    candidate.insert(candidate.end(), spur_route->edges.begin(), spur_route->edges.end());
+                    if (seen.insert(GetCanonicalEdges(candidate)).second) {
+                        candidates.push({RouteInfo{root_weight + spur_route->weight, std::move(candidate)}, i});
+                    }
+                }
+            }
+            root_vertices.push_back(spur);
+            const auto& edge = graph_.GetEdge(edges[i]);
+            root_weight += edge.weight;
+            spur = edge.to;
+        }
+
+        if (candidates.empty()) {
+            break;
+        }
+        next = candidates.top();
+        candidates.pop();
+    }
+    return result;
+}
+
+template <typename Weight>
+std::optional<typename KShortestPaths<Weight>::RouteInfo> KShortestPaths<Weight>::FindSpur(
+        VertexId from, VertexId to, const std::vector<VertexId>& blocked, const std::vector<EdgeId>& removed) {
+    ++generation_;
+    for (const VertexId vertex : blocked) {
+        blocked_[vertex] = generation_;
+    }
+
+    // Очередь по весу пути плюс оценке остатка
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    reached_[from] = generation_;
+    distance_[from] = Weight{};
+    queue.push({Weight{}, from});
+
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (settled_[vertex] == generation_) {
+            continue;
+        }
+        settled_[vertex] = generation_;
+        if (vertex == to) {
+            break;
+        }
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (blocked_[edge.to] == generation_ || settled_[edge.to] == generation_) {
+                continue;
+            }
+            if (vertex == from && std::any_of(removed.begin(), removed.end(), [&](EdgeId removed_id) {
+                    return IsInterchangeable(removed_id, edge_id);
+                })) {
+                continue;
+            }
+            // Из вершины, откуда цель недостижима и без удалённых рёбер, идти незачем
+            const auto estimate = router_.GetRouteWeight(edge.to, to);
+            if (!estimate) {
+                continue;
+            }
+            const Weight distance = distance_[vertex] + edge.weight;
+            if (reached_[edge.to] != generation_ || distance < distance_[edge.to]) {
+                reached_[edge.to] = generation_;
+                distance_[edge.to] = distance;
+                prev_edge_[edge.to] = edge_id;
+                queue.push({distance + *estimate, edge.to});
+            }
+        }
+    }
+
+    if (settled_[to] != generation_) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (VertexId vertex = to; vertex != from; vertex = graph_.GetEdge(prev_edge_[vertex]).from) {
+        edges.push_back(prev_edge_[vertex]);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return RouteInfo{distance_[to], std::move(edges)};
+}
+
+template <typename Weight>
+bool KShortestPaths<Weight>::IsInterchangeable(EdgeId lhs, EdgeId rhs) const {
+    if (lhs == rhs) {
+        return true;
+    }
+    const auto& lhs_edge = graph_.GetEdge(lhs);
+    const auto& rhs_edge = graph_.GetEdge(rhs);
+    return lhs_edge.from == rhs_edge.from && lhs_edge.to == rhs_edge.to && lhs_edge.weight == rhs_edge.weight;
+}
+
+template <typename Weight>
+std::vector<EdgeId> KShortestPaths<Weight>::GetCanonicalEdges(const std::vector<EdgeId>& edges) const {
+    std::vector<EdgeId> result;
+    result.reserve(edges.size());
+    for (const EdgeId edge_id : edges) {
+        for (const EdgeId other : graph_.GetIncidentEdges(graph_.GetEdge(edge_id).from)) {
+            if (IsInterchangeable(other, edge_id)) {
+                result.push_back(other);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+}  // namespace graph
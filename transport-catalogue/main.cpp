@@ -1,12 +1,183 @@
 #include "json_reader.h"
+#include "metrics.h"
+#include "query_server.h"
+#include "trace.h"
 #include "transport_router.h"
+
+#include <cctype>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std::literals;
+
+namespace {
+
+struct Options {
+    // --compact: ответ выводится одной строкой без отступов
+    json::PrintMode print_mode = json::PrintMode::PRETTY;
+    // --serve: после загрузки базы отвечать на запросы по одному на строку
+    bool serve = false;
+    // --base FILE: база читается из файла, а не из stdin
+    std::string base_path;
+    // --socket PATH: в режиме --serve запросы принимаются на Unix-сокете
+    std::string socket_path;
+    // --capture FILE: в режиме --serve каждый запрос записывается в FILE со временем
+    // прихода; журнал воспроизводится программой replay
+    std::string capture_path;
+    // --metrics: время, прирост пикового RSS и число аллокаций по этапам, размеры графа
+    // выводятся в stderr в JSON; --metrics-file FILE — в файл
+    bool metrics = false;
+    std::string metrics_path;
+    // --router-memory-limit MB: не строить таблицу маршрутизатора, если она
+    // по оценке займёт больше MB мегабайт
+    std::optional<size_t> router_memory_limit;
+    // --trace FILE: интервалы выполнения пишутся в FILE в формате Chrome trace_event
+    // (открывается в Perfetto); нужна сборка с -DTRANSPORT_TRACE
+    std::string trace_path;
+};
+
+// Размер в мегабайтах -> байты. Отрицательные, нечисловые и не помещающиеся
+// в size_t значения — ошибка использования
+size_t ParseMegabytes(std::string_view option, const std::string& text) {
+    const auto usage_error = [&] {
+        return std::invalid_argument(std::string(option) + " expects a size in megabytes from 0 to "s
+                                     + std::to_string(SIZE_MAX >> 20) + ", got '"s + text + "'"s);
+    };
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text.front()))) {
+        throw usage_error();
+    }
+    size_t parsed = 0;
+    unsigned long long megabytes = 0;
+    try {
+        megabytes = std::stoull(text, &parsed);
+    } catch (const std::logic_error&) {
+        throw usage_error();
+    }
+    if (parsed != text.size() || megabytes > (SIZE_MAX >> 20)) {
+        throw usage_error();
+    }
+    return static_cast<size_t>(megabytes) << 20;
+}
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(std::string(arg) + " expects a value"s);
+            }
+            return argv[++i];
+        };
 
-int main() {
+        if (arg == "--compact"sv) {
+            options.print_mode = json::PrintMode::COMPACT;
+        } else if (arg == "--serve"sv) {
+            options.serve = true;
+        } else if (arg == "--base"sv) {
+            options.base_path = value();
+        } else if (arg == "--socket"sv) {
+            options.socket_path = value();
+        } else if (arg == "--capture"sv) {
+            options.capture_path = value();
+        } else if (arg == "--metrics"sv) {
+            options.metrics = true;
+        } else if (arg == "--router-memory-limit"sv) {
+            options.router_memory_limit = ParseMegabytes(arg, value());
+        } else if (arg == "--trace"sv) {
+            options.trace_path = value();
+        } else if (arg == "--metrics-file"sv) {
+            options.metrics = true;
+            options.metrics_path = value();
+        } else {
+            throw std::invalid_argument("Unknown option "s + std::string(arg));
+        }
+    }
+    if (options.serve && options.base_path.empty() && options.socket_path.empty()) {
+        throw std::invalid_argument("--serve reads requests from stdin, so the base needs --base FILE"s);
+    }
+    if (!options.capture_path.empty() && !options.serve) {
+        throw std::invalid_argument("--capture records requests of --serve"s);
+    }
+    if (!options.trace_path.empty() && !trace::IsCompiledIn()) {
+        throw std::invalid_argument("--trace needs a build with -DTRANSPORT_TRACE"s);
+    }
+    return options;
+}
+
+json::Document LoadBase(const Options& options) {
+    if (options.base_path.empty()) {
+        return json::Load(std::cin);
+    }
+    std::ifstream input(options.base_path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Cannot open "s + options.base_path);
+    }
+    return json::Load(input);
+}
+
+void WriteTrace(const Options& options) {
+    if (options.trace_path.empty()) {
+        return;
+    }
+    std::ofstream output(options.trace_path, std::ios::binary);
+    if (!output) {
+        std::cerr << "Cannot open "s << options.trace_path << std::endl;
+        return;
+    }
+    trace::WriteChromeTrace(output);
+}
+
+void WriteMetrics(const Options& options, const metrics::Recorder& recorder) {
+    if (!recorder.IsEnabled()) {
+        return;
+    }
+    if (options.metrics_path.empty()) {
+        json::Print(recorder.ToJson(), std::cerr, json::PrintMode::COMPACT);
+        std::cerr << std::endl;
+        return;
+    }
+    std::ofstream output(options.metrics_path, std::ios::binary);
+    if (!output) {
+        std::cerr << "Cannot open "s << options.metrics_path << std::endl;
+        return;
+    }
+    json::Print(recorder.ToJson(), output, json::PrintMode::PRETTY);
+    output << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::logic_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (!options.trace_path.empty()) {
+        trace::Start();
+    }
+    metrics::Recorder recorder(options.metrics);
     transport_catalogue::TransportCatalogue catalogue;
     transport::RoutingSettings routing_settings;
 
-    auto doc = json::Load(std::cin);
+    json::Document doc{nullptr};
+    try {
+        recorder.Measure("load", [&] {
+            doc = LoadBase(options);
+        });
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
     const auto& root_map = doc.GetRoot().AsDict();
 
     if (root_map.count("routing_settings")) {
@@ -20,20 +191,80 @@ int main() {
     JsonReader reader(catalogue, router);
 
     if (root_map.count("base_requests")) {
-        reader.ParsingBaseRequests(root_map.at("base_requests").AsArray());
+        recorder.Measure("base_requests", [&] {
+            reader.ParsingBaseRequests(root_map.at("base_requests").AsArray());
+        });
     }
 
-    // BuildGraph без параметров
-    router.BuildGraph();
+    recorder.SetCount("router_table_bytes_predicted", router.PredictRouterTableBytes());
+    router.SetRouterMemoryLimit(options.router_memory_limit);
+    try {
+        recorder.Measure("build_graph", [&] {
+            router.BuildGraph();
+        });
+    } catch (const std::length_error& e) {
+        std::cerr << e.what() << std::endl;
+        WriteMetrics(options, recorder);
+        WriteTrace(options);
+        return 1;
+    }
+    recorder.AddMemoryReport(catalogue.GetMemoryReport());
+    recorder.AddMemoryReport(router.GetMemoryReport());
+    recorder.SetCount("stops", catalogue.GetStops().size());
+    recorder.SetCount("buses", catalogue.GetBuses().size());
+    recorder.SetCount("graph_vertices", router.GetVertexCount());
+    recorder.SetCount("graph_edges", router.GetEdgeCount());
+    recorder.SetCount("router_table_entries", router.GetRouterTableSize());
 
     if (root_map.count("render_settings")) {
-        reader.ParsingRenderSettings(root_map.at("render_settings").AsDict());
+        recorder.Measure("render_settings", [&] {
+            reader.ParsingRenderSettings(root_map.at("render_settings").AsDict());
+        });
+    }
+
+    if (options.serve) {
+        QueryServer server(reader, recorder.GetRequestLatencies());
+        std::ofstream capture;
+        if (!options.capture_path.empty()) {
+            capture.open(options.capture_path, std::ios::binary);
+            if (!capture) {
+                std::cerr << "Cannot open "s << options.capture_path << std::endl;
+                return 1;
+            }
+            server.SetCapture(capture);
+        }
+        int status = 0;
+        try {
+            recorder.Measure("serve", [&] {
+                if (!options.socket_path.empty()) {
+                    server.ServeUnixSocket(options.socket_path);
+                } else {
+                    server.Serve(std::cin, std::cout);
+                }
+            });
+        } catch (const std::exception& e) {
+            // Например, путь сокета занят обычным файлом или недоступен
+            std::cerr << e.what() << std::endl;
+            status = 1;
+        }
+        WriteMetrics(options, recorder);
+        WriteTrace(options);
+        return status;
     }
 
     if (root_map.count("stat_requests")) {
-        auto response = reader.ParsingStatRequests(root_map.at("stat_requests").AsArray());
-        json::Print(response, std::cout);
+        const auto& stat_requests = root_map.at("stat_requests").AsArray();
+        recorder.SetCount("stat_requests", stat_requests.size());
+        json::Document response{nullptr};
+        recorder.Measure("stat_requests", [&] {
+            response = reader.ParsingStatRequests(stat_requests, recorder.GetRequestLatencies());
+        });
+        recorder.Measure("print", [&] {
+            json::Print(response, std::cout, options.print_mode);
+        });
     }
 
+    WriteMetrics(options, recorder);
+    WriteTrace(options);
     return 0;
 }
@@ -1,22 +1,49 @@
 #include "map_renderer.h"
 #include "geo.h"
 #include "svg.h"
+#include "parallel.h"
+#include "trace.h"
 
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <sstream>
 #include <unordered_set>
 #include <vector>
 
 using namespace std;
 
 inline const double EPSILON = 1e-6;
+const svg::Color NONE_COLOR = "none"s;
+const svg::Color WHITE_COLOR = "white"s;
+const svg::Color BLACK_COLOR = "black"s;
+// Глубже упрощённые линии не различаются: допуск уже меньше миллионной доли пикселя
+constexpr int MAX_DETAIL_LEVEL = 20;
+// Меньше объектов на поток не окупает его запуск
+constexpr size_t MIN_OBJECTS_PER_THREAD = 512;
+
 bool IsZero(double value) {
     return std::abs(value) < EPSILON;
 }
 
+// Цвет изохроны: 0 — зелёный, 0.5 — жёлтый, 1 — красный
+svg::Color HeatColor(double fraction) {
+    fraction = std::clamp(fraction, 0.0, 1.0);
+    return svg::Rgba{
+        static_cast<uint8_t>(std::lround(255 * std::min(1.0, 2 * fraction))),
+        static_cast<uint8_t>(std::lround(255 * std::min(1.0, 2 * (1 - fraction)))),
+        0,
+        0.85
+    };
+}
+
 template <typename PointInputIt>
 SphereProjector::SphereProjector(PointInputIt points_begin, PointInputIt points_end,
                                double max_width, double max_height, double padding)
-    : padding_(padding)
+    : offset_x_(padding)
+    , offset_y_(padding)
 {
     if (points_begin == points_end) {
         return;
@@ -55,44 +82,667 @@ SphereProjector::SphereProjector(PointInputIt points_begin, PointInputIt points_
 
 svg::Point SphereProjector::operator()(Coordinates coords) const {
     return {
-        (coords.lng - min_lon_) * zoom_coeff_ + padding_,
-        (max_lat_ - coords.lat) * zoom_coeff_ + padding_
+        (coords.lng - min_lon_) * zoom_coeff_ + offset_x_,
+        (max_lat_ - coords.lat) * zoom_coeff_ + offset_y_
     };
 }
 
+SphereProjector SphereProjector::Scaled(double scale, svg::Point origin) const {
+    SphereProjector result = *this;
+    result.zoom_coeff_ = zoom_coeff_ * scale;
+    result.offset_x_ = (offset_x_ - origin.x) * scale;
+    result.offset_y_ = (offset_y_ - origin.y) * scale;
+    return result;
+}
+
+optional<Rect> SphereProjector::Unproject(const Rect& rect) const {
+    if (IsZero(zoom_coeff_)) {
+        return nullopt;
+    }
+    return Rect{
+        (rect.min_x - offset_x_) / zoom_coeff_ + min_lon_,
+        max_lat_ - (rect.max_y - offset_y_) / zoom_coeff_,
+        (rect.max_x - offset_x_) / zoom_coeff_ + min_lon_,
+        max_lat_ - (rect.min_y - offset_y_) / zoom_coeff_
+    };
+}
+
+namespace {
+
+template <typename T>
+void HashCombine(size_t& seed, const T& value) {
+    seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+void HashColor(size_t& seed, const svg::Color& color) {
+    HashCombine(seed, color.index());
+    if (const auto* name = std::get_if<std::string>(&color)) {
+        HashCombine(seed, *name);
+    } else if (const auto* rgb = std::get_if<svg::Rgb>(&color)) {
+        HashCombine(seed, rgb->red);
+        HashCombine(seed, rgb->green);
+        HashCombine(seed, rgb->blue);
+    } else if (const auto* rgba = std::get_if<svg::Rgba>(&color)) {
+        HashCombine(seed, rgba->red);
+        HashCombine(seed, rgba->green);
+        HashCombine(seed, rgba->blue);
+        HashCombine(seed, rgba->opacity);
+    }
+}
+
+}  // namespace
+
+size_t HashRenderSettings(const RenderSettings& settings) {
+    size_t seed = 0;
+    HashCombine(seed, settings.width);
+    HashCombine(seed, settings.height);
+    HashCombine(seed, settings.padding);
+    HashCombine(seed, settings.line_width);
+    HashCombine(seed, settings.stop_radius);
+    HashCombine(seed, settings.bus_label_font_size);
+    HashCombine(seed, settings.bus_label_offset.first);
+    HashCombine(seed, settings.bus_label_offset.second);
+    HashCombine(seed, settings.stop_label_font_size);
+    HashCombine(seed, settings.stop_label_offset.first);
+    HashCombine(seed, settings.stop_label_offset.second);
+    HashColor(seed, settings.underlayer_color);
+    HashCombine(seed, settings.underlayer_width);
+    for (const auto& color : settings.color_palette) {
+        HashColor(seed, color);
+    }
+    HashCombine(seed, settings.simplify_tolerance);
+    HashCombine(seed, settings.style_classes);
+    HashCombine(seed, settings.coordinate_precision.value_or(-1));
+    return seed;
+}
+
 MapRenderer::MapRenderer(const transport_catalogue::TransportCatalogue& catalogue,
                        const RenderSettings& render_settings)
-    : catalogue_(catalogue), render_settings_(render_settings) {}
+    : catalogue_(catalogue)
+    , render_settings_(render_settings)
+    , settings_hash_(HashRenderSettings(render_settings)) {
+    if (render_settings_.style_classes) {
+        style_classes_ = MakeStyleClasses(render_settings_);
+    }
+}
 
-void MapRenderer::Render(svg::Document& doc) const {
-    vector<Coordinates> allCoordinates = CollectAllCoordinates();
-    SphereProjector projector = CreateProjector(allCoordinates);
+// Классы: r — линия маршрута, s<i> — её цвет из палитры; bl и sl — шрифты подписей
+// автобусов и остановок, f<i> и k — цвет подписи, u — подложка; sc — круг остановки.
+// Подложка и подпись делят шрифтовой класс, а цвет у них в разных классах,
+// поэтому правила не перекрывают друг друга
+MapRenderer::StyleClasses MapRenderer::MakeStyleClasses(const RenderSettings& settings) {
+    ostringstream css;
+    css << ".r{fill:none;stroke-width:"sv << settings.line_width
+        << "px;stroke-linecap:round;stroke-linejoin:round}"sv;
+    css << ".bl{font-size:"sv << settings.bus_label_font_size
+        << "px;font-family:Verdana;font-weight:bold}"sv;
+    css << ".sl{font-size:"sv << settings.stop_label_font_size << "px;font-family:Verdana}"sv;
+    css << ".u{fill:"sv << settings.underlayer_color << ";stroke:"sv << settings.underlayer_color
+        << ";stroke-width:"sv << settings.underlayer_width
+        << "px;stroke-linecap:round;stroke-linejoin:round}"sv;
+    css << ".k{fill:"sv << BLACK_COLOR << "}.sc{fill:"sv << WHITE_COLOR << '}';
+
+    StyleClasses classes;
+    for (size_t i = 0; i < settings.color_palette.size(); ++i) {
+        const auto& color = settings.color_palette[i];
+        css << ".s"sv << i << "{stroke:"sv << color << "}.f"sv << i << "{fill:"sv << color << '}';
+        classes.routes.push_back("r s"s + to_string(i));
+        classes.bus_labels.push_back("bl f"s + to_string(i));
+    }
+    classes.style_sheet = css.str();
+    return classes;
+}
 
-    vector<const transport_catalogue::Bus*> buses = GetSortedNonEmptyBuses();
-    RenderBusRoutes(doc, buses, projector);
-    RenderBusLabels(doc, buses, projector);
+const std::string& MapRenderer::GetMapSvg() const {
+    const uint64_t version = catalogue_.GetVersion();
+    if (!cached_map_ || cached_map_->catalogue_version != version) {
+        TRACE_SCOPE("MapRenderer::GetMapSvg");
+        const Layout& layout = GetLayout();
+        UpdateFragments(layout);
+
+        size_t size = 0;
+        for (const auto& [bus, fragment] : fragments_->buses) {
+            size += fragment.route.size() + fragment.labels.size();
+        }
+        for (const auto& [stop, fragment] : fragments_->stops) {
+            size += fragment.circle.size() + fragment.label.size();
+        }
+        std::string svg;
+        svg.reserve(size + (style_classes_ ? style_classes_->style_sheet.size() : 0) + 256);
+
+        // Слои собираются из фрагментов в порядке полной карты
+        svg::Writer writer(svg);
+        writer.BeginDocument();
+        if (style_classes_) {
+            writer.WriteStyleSheet(style_classes_->style_sheet);
+        }
+        for (const auto* bus : layout.buses) {
+            writer.WriteFragment(fragments_->buses.at(bus).route);
+        }
+        for (const auto* bus : layout.buses) {
+            writer.WriteFragment(fragments_->buses.at(bus).labels);
+        }
+        for (const auto* stop : layout.stops) {
+            writer.WriteFragment(fragments_->stops.at(stop).circle);
+        }
+        for (const auto* stop : layout.stops) {
+            writer.WriteFragment(fragments_->stops.at(stop).label);
+        }
+        writer.EndDocument();
 
-    vector<const transport_catalogue::Stop*> stopsToRender = GetSortedBusStops();
-    RenderStopCircles(doc, stopsToRender, projector);
-    RenderStopLabels(doc, stopsToRender, projector);
+        cached_map_ = CachedMap{version, std::move(svg)};
+    }
+    return cached_map_->svg;
 }
 
-vector<Coordinates> MapRenderer::CollectAllCoordinates() const {
-    vector<Coordinates> coordinates;
-    unordered_set<const transport_catalogue::Stop*> uniqueStops;
+void MapRenderer::UpdateFragments(const Layout& layout) const {
+    TRACE_SCOPE("MapRenderer::UpdateFragments");
+    const bool reusable = fragments_ && fragments_->projector == layout.projector;
+    const size_t palette_size = render_settings_.color_palette.size();
+
+    // Годные фрагменты переносятся в новый набор, пропавшие объекты отбрасываются
+    MapFragments updated{layout.projector, {}, {}};
+    updated.buses.reserve(layout.buses.size());
+    updated.stops.reserve(layout.stops.size());
+
+    vector<size_t> bus_ids;
+    for (size_t i = 0; i < layout.buses.size(); ++i) {
+        if (reusable) {
+            auto node = fragments_->buses.extract(layout.buses[i]);
+            if (!node.empty() && node.mapped().color_index == i % palette_size) {
+                updated.buses.insert(std::move(node));
+                continue;
+            }
+        }
+        bus_ids.push_back(i);
+    }
+    vector<size_t> stop_ids;
+    for (size_t i = 0; i < layout.stops.size(); ++i) {
+        if (reusable) {
+            auto node = fragments_->stops.extract(layout.stops[i]);
+            if (!node.empty()) {
+                updated.stops.insert(std::move(node));
+                continue;
+            }
+        }
+        stop_ids.push_back(i);
+    }
 
-    for (const auto& bus : catalogue_.GetBuses()) {
-        for (const auto* stop : bus.stops) {
-            if (uniqueStops.insert(stop).second) {
-                coordinates.push_back(stop->coordinates);
+    // Кэш упрощённых линий заполняется до запуска потоков
+    const RouteShapes* shapes = GetRouteShapes(layout, layout.projector);
+    vector<BusFragments> bus_fragments(bus_ids.size());
+    vector<StopFragments> stop_fragments(stop_ids.size());
+
+    auto render = [&](std::string& fragment, auto draw) {
+        svg::Writer writer(fragment);
+        writer.SetCoordinatePrecision(render_settings_.coordinate_precision);
+        draw(writer);
+    };
+    const size_t total = bus_ids.size() + stop_ids.size();
+    parallel::ForEachChunk(total, parallel::ChooseThreadCount(total, MIN_OBJECTS_PER_THREAD),
+                           [&](size_t, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            if (k < bus_ids.size()) {
+                const span<const size_t> id(&bus_ids[k], 1);
+                auto& fragment = bus_fragments[k];
+                fragment.color_index = bus_ids[k] % palette_size;
+                render(fragment.route, [&](svg::Writer& writer) {
+                    RenderBusRoutes(writer, layout.buses, id, shapes, layout.projector);
+                });
+                render(fragment.labels, [&](svg::Writer& writer) {
+                    RenderBusLabels(writer, layout.buses, id, layout.projector);
+                });
+            } else {
+                const size_t index = k - bus_ids.size();
+                const span<const size_t> id(&stop_ids[index], 1);
+                auto& fragment = stop_fragments[index];
+                render(fragment.circle, [&](svg::Writer& writer) {
+                    RenderStopCircles(writer, layout.stops, id, layout.projector);
+                });
+                render(fragment.label, [&](svg::Writer& writer) {
+                    RenderStopLabels(writer, layout.stops, id, layout.projector);
+                });
             }
         }
+    });
+
+    for (size_t k = 0; k < bus_ids.size(); ++k) {
+        updated.buses.emplace(layout.buses[bus_ids[k]], std::move(bus_fragments[k]));
+    }
+    for (size_t k = 0; k < stop_ids.size(); ++k) {
+        updated.stops.emplace(layout.stops[stop_ids[k]], std::move(stop_fragments[k]));
+    }
+    fragments_ = std::move(updated);
+}
+
+void MapRenderer::Render(svg::Writer& writer) const {
+    const Layout& layout = GetLayout();
+
+    vector<size_t> bus_ids(layout.buses.size());
+    iota(bus_ids.begin(), bus_ids.end(), 0);
+    vector<size_t> stop_ids(layout.stops.size());
+    iota(stop_ids.begin(), stop_ids.end(), 0);
+
+    RenderLayers(writer, layout, bus_ids, stop_ids, layout.projector);
+}
+
+std::string MapRenderer::RenderTile(const MapTile& tile) const {
+    TRACE_SCOPE("MapRenderer::RenderTile");
+    const Layout& layout = GetLayout();
+    const double scale = std::ldexp(1.0, tile.zoom);
+    const SphereProjector view = layout.projector.Scaled(
+        scale, {tile.x * render_settings_.width / scale, tile.y * render_settings_.height / scale});
+    return RenderView(layout, view);
+}
+
+std::string MapRenderer::RenderBounds(const GeoBounds& bounds) const {
+    TRACE_SCOPE("MapRenderer::RenderBounds");
+    const Layout& layout = GetLayout();
+    const Coordinates corners[] = {bounds.min, bounds.max};
+    return RenderView(layout, CreateProjector(std::begin(corners), std::end(corners)));
+}
+
+std::string MapRenderer::RenderRouteMap(span<const RouteLeg> legs) const {
+    TRACE_SCOPE("MapRenderer::RenderRouteMap");
+    const std::string& base = GetMapSvg();
+    const Layout& layout = GetLayout();
+    const string_view document_end = "</svg>"sv;
+
+    std::string svg;
+    svg.reserve(base.size() + legs.size() * 256);
+    svg.append(base, 0, base.size() - document_end.size());
+
+    svg::Writer writer(svg);
+    writer.SetCoordinatePrecision(render_settings_.coordinate_precision);
+
+    // Поездка — линия цвета автобуса поверх подложки, чтобы выделяться
+    // на фоне других маршрутов; остановки посадки и высадки отмечены кругами
+    svg::PathStyle halo_style = UnderlayerStyle();
+    halo_style.fill_color = &NONE_COLOR;
+    halo_style.stroke_width = render_settings_.line_width + 2 * render_settings_.underlayer_width;
+
+    auto write_leg = [&](const RouteLeg& leg) {
+        writer.BeginPolyline();
+        for (size_t span = 0; span <= leg.span_count; ++span) {
+            const size_t index = leg.backward ? leg.first_stop_index - span : leg.first_stop_index + span;
+            writer.AddPolylinePoint(layout.projector(leg.bus->stops[index]->coordinates));
+        }
+    };
+    for (const auto& leg : legs) {
+        write_leg(leg);
+        writer.EndPolyline(halo_style);
+
+        // Цвет — тот же, что у автобуса на карте
+        const auto it = lower_bound(layout.buses.begin(), layout.buses.end(), leg.bus,
+                                    [](const auto* lhs, const auto* rhs) { return lhs->name < rhs->name; });
+        const size_t color_index = static_cast<size_t>(it - layout.buses.begin()) % render_settings_.color_palette.size();
+
+        svg::PathStyle style;
+        style.fill_color = &NONE_COLOR;
+        style.stroke_color = &render_settings_.color_palette[color_index];
+        style.stroke_width = render_settings_.line_width;
+        style.stroke_linecap = svg::StrokeLineCap::ROUND;
+        style.stroke_linejoin = svg::StrokeLineJoin::ROUND;
+        write_leg(leg);
+        writer.EndPolyline(style);
+    }
+
+    svg::PathStyle stop_style;
+    stop_style.fill_color = &WHITE_COLOR;
+    stop_style.stroke_color = &BLACK_COLOR;
+    stop_style.stroke_width = render_settings_.underlayer_width;
+    for (const auto& leg : legs) {
+        const size_t last = leg.backward ? leg.first_stop_index - leg.span_count : leg.first_stop_index + leg.span_count;
+        for (const size_t index : {leg.first_stop_index, last}) {
+            writer.WriteCircle(layout.projector(leg.bus->stops[index]->coordinates), render_settings_.stop_radius, stop_style);
+        }
+    }
+
+    writer.EndDocument();
+    return svg;
+}
+
+std::string MapRenderer::RenderIsochroneMap(span<const IsochroneStop> stops, double max_time) const {
+    TRACE_SCOPE_ARG("MapRenderer::RenderIsochroneMap", "stops", static_cast<int64_t>(stops.size()));
+    const std::string& base = GetMapSvg();
+    const Layout& layout = GetLayout();
+    const string_view document_end = "</svg>"sv;
+
+    std::string svg;
+    svg.reserve(base.size() + stops.size() * 96);
+    svg.append(base, 0, base.size() - document_end.size());
+
+    svg::Writer writer(svg);
+    writer.SetCoordinatePrecision(render_settings_.coordinate_precision);
+
+    // Дальние остановки выводятся первыми, чтобы ближние оставались сверху
+    vector<const IsochroneStop*> order;
+    order.reserve(stops.size());
+    for (const auto& stop : stops) {
+        order.push_back(&stop);
+    }
+    stable_sort(order.begin(), order.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->time > rhs->time;
+    });
+
+    svg::PathStyle style;
+    style.stroke_color = &BLACK_COLOR;
+    style.stroke_width = render_settings_.underlayer_width / 2;
+    for (const auto* stop : order) {
+        const svg::Color color = HeatColor(max_time > 0 ? stop->time / max_time : 0.0);
+        style.fill_color = &color;
+        writer.WriteCircle(layout.projector(stop->stop->coordinates), render_settings_.stop_radius * 2, style);
     }
-    return coordinates;
+
+    writer.EndDocument();
+    return svg;
 }
 
-SphereProjector MapRenderer::CreateProjector(const vector<Coordinates>& coordinates) const {
-    return SphereProjector(coordinates.begin(), coordinates.end(),
+void MapRenderer::RenderLayers(svg::Writer& writer, const Layout& layout,
+                               const vector<size_t>& bus_ids,
+                               const vector<size_t>& stop_ids,
+                               const SphereProjector& projector) const {
+    TRACE_SCOPE("MapRenderer::RenderLayers");
+    // Кэш упрощённых линий заполняется до запуска потоков
+    const RouteShapes* shapes = GetRouteShapes(layout, projector);
+
+    // Четыре слоя идут подряд в одной нумерации: сначала линии, затем подписи
+    // автобусов, круги и подписи остановок. Кусок этой нумерации может задевать
+    // несколько слоёв и выводит их части в том же порядке
+    const size_t layer_ends[] = {
+        bus_ids.size(),
+        bus_ids.size() * 2,
+        bus_ids.size() * 2 + stop_ids.size(),
+        bus_ids.size() * 2 + stop_ids.size() * 2
+    };
+    auto render_range = [&](svg::Writer& out, size_t begin, size_t end) {
+        auto part = [&](size_t layer, span<const size_t> ids) {
+            const size_t layer_begin = layer == 0 ? 0 : layer_ends[layer - 1];
+            const size_t from = std::clamp(begin, layer_begin, layer_ends[layer]) - layer_begin;
+            const size_t to = std::clamp(end, layer_begin, layer_ends[layer]) - layer_begin;
+            return ids.subspan(from, to - from);
+        };
+        RenderBusRoutes(out, layout.buses, part(0, bus_ids), shapes, projector);
+        RenderBusLabels(out, layout.buses, part(1, bus_ids), projector);
+        RenderStopCircles(out, layout.stops, part(2, stop_ids), projector);
+        RenderStopLabels(out, layout.stops, part(3, stop_ids), projector);
+    };
+
+    writer.SetCoordinatePrecision(render_settings_.coordinate_precision);
+    writer.BeginDocument();
+    if (style_classes_) {
+        writer.WriteStyleSheet(style_classes_->style_sheet);
+    }
+
+    const size_t total = layer_ends[3];
+    const size_t chunk_count = parallel::ChooseThreadCount(total, MIN_OBJECTS_PER_THREAD);
+    if (chunk_count == 1) {
+        render_range(writer, 0, total);
+    } else {
+        vector<std::string> chunks(chunk_count);
+        parallel::ForEachChunk(total, chunk_count, [&](size_t chunk, size_t begin, size_t end) {
+            TRACE_SCOPE_ARG("MapRenderer::RenderChunk", "chunk", static_cast<int64_t>(chunk));
+            svg::Writer chunk_writer(chunks[chunk]);
+            chunk_writer.SetCoordinatePrecision(render_settings_.coordinate_precision);
+            render_range(chunk_writer, begin, end);
+        });
+        for (const auto& chunk : chunks) {
+            writer.WriteFragment(chunk);
+        }
+    }
+
+    writer.EndDocument();
+}
+
+namespace {
+
+// Ширина символа подписи в долях размера шрифта, с запасом для жирного Verdana
+constexpr double GLYPH_WIDTH = 0.75;
+
+Rect PointBox(svg::Point point, double radius) {
+    return {point.x - radius, point.y - radius, point.x + radius, point.y + radius};
+}
+
+// Приблизительная область подписи вместе с подложкой
+Rect LabelBox(svg::Point point, pair<double, double> offset, int font_size,
+              size_t length, double stroke_width) {
+    const double x = point.x + offset.first;
+    const double y = point.y + offset.second;
+    return {x - stroke_width,
+            y - font_size - stroke_width,
+            x + static_cast<double>(length) * font_size * GLYPH_WIDTH + stroke_width,
+            y + font_size * 0.5 + stroke_width};
+}
+
+// Квадрат расстояния от точки p до отрезка [a, b]
+double SquaredDistanceToSegment(svg::Point p, svg::Point a, svg::Point b) {
+    const double dx = b.x - a.x;
+    const double dy = b.y - a.y;
+    const double length = dx * dx + dy * dy;
+    double t = 0;
+    if (length > 0) {
+        t = std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / length, 0.0, 1.0);
+    }
+    const double ex = a.x + t * dx - p.x;
+    const double ey = a.y + t * dy - p.y;
+    return ex * ex + ey * ey;
+}
+
+// Алгоритм Дугласа — Пекера: номера точек, которые нужно оставить, чтобы
+// ломаная отклонялась от исходной не больше чем на tolerance. Крайние точки
+// остаются всегда
+vector<uint32_t> SimplifyPolyline(const vector<svg::Point>& points, double tolerance) {
+    if (points.size() <= 2) {
+        vector<uint32_t> all(points.size());
+        iota(all.begin(), all.end(), 0);
+        return all;
+    }
+
+    const double squared_tolerance = tolerance * tolerance;
+    vector<bool> keep(points.size());
+    keep.front() = keep.back() = true;
+
+    vector<pair<size_t, size_t>> ranges{{0, points.size() - 1}};
+    while (!ranges.empty()) {
+        const auto [first, last] = ranges.back();
+        ranges.pop_back();
+
+        double max_distance = 0;
+        size_t farthest = first;
+        for (size_t i = first + 1; i < last; ++i) {
+            const double distance = SquaredDistanceToSegment(points[i], points[first], points[last]);
+            if (distance > max_distance) {
+                max_distance = distance;
+                farthest = i;
+            }
+        }
+        if (max_distance > squared_tolerance) {
+            keep[farthest] = true;
+            ranges.emplace_back(first, farthest);
+            ranges.emplace_back(farthest, last);
+        }
+    }
+
+    vector<uint32_t> kept;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (keep[i]) {
+            kept.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return kept;
+}
+
+Rect GeoBox(Coordinates from, Coordinates to) {
+    return {std::min(from.lng, to.lng), std::min(from.lat, to.lat),
+            std::max(from.lng, to.lng), std::max(from.lat, to.lat)};
+}
+
+}  // namespace
+
+std::string MapRenderer::RenderView(const Layout& layout, const SphereProjector& view) const {
+    const Rect view_rect{0, 0, render_settings_.width, render_settings_.height};
+
+    // Окно, расширенное на наибольший размер подписи, переводится в географические
+    // координаты и служит запросом к индексам; точная проверка — уже в пикселях вида
+    const double label_extent = std::max(
+        abs(render_settings_.bus_label_offset.first) + abs(render_settings_.bus_label_offset.second)
+            + static_cast<double>(layout.max_bus_name_length + 1) * render_settings_.bus_label_font_size * GLYPH_WIDTH,
+        abs(render_settings_.stop_label_offset.first) + abs(render_settings_.stop_label_offset.second)
+            + static_cast<double>(layout.max_stop_name_length + 1) * render_settings_.stop_label_font_size * GLYPH_WIDTH);
+    const double margin = std::max({label_extent + render_settings_.underlayer_width,
+                                    render_settings_.stop_radius, render_settings_.line_width});
+    const optional<Rect> query = view.Unproject({view_rect.min_x - margin, view_rect.min_y - margin,
+                                                 view_rect.max_x + margin, view_rect.max_y + margin});
+
+    auto bus_visible = [&](size_t id) {
+        const auto* bus = layout.buses[id];
+        const auto& stops = bus->stops;
+        for (size_t i = 0; i < stops.size(); ++i) {
+            const svg::Point from = view(stops[i]->coordinates);
+            const svg::Point to = view(stops[i + 1 < stops.size() ? i + 1 : i]->coordinates);
+            Rect segment{std::min(from.x, to.x), std::min(from.y, to.y), std::max(from.x, to.x), std::max(from.y, to.y)};
+            segment = {segment.min_x - render_settings_.line_width, segment.min_y - render_settings_.line_width,
+                       segment.max_x + render_settings_.line_width, segment.max_y + render_settings_.line_width};
+            if (segment.Intersects(view_rect)) {
+                return true;
+            }
+        }
+        for (const auto* terminal : {stops.front(), stops.back()}) {
+            if (LabelBox(view(terminal->coordinates), render_settings_.bus_label_offset,
+                         render_settings_.bus_label_font_size, bus->name.size(),
+                         render_settings_.underlayer_width).Intersects(view_rect)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto stop_visible = [&](size_t id) {
+        const auto* stop = layout.stops[id];
+        const svg::Point point = view(stop->coordinates);
+        return PointBox(point, render_settings_.stop_radius).Intersects(view_rect)
+            || LabelBox(point, render_settings_.stop_label_offset, render_settings_.stop_label_font_size,
+                        stop->name.size(), render_settings_.underlayer_width).Intersects(view_rect);
+    };
+
+    // Кандидаты из индекса; порядок вывода (и цвета автобусов) — как на полной карте
+    auto collect = [](const GridIndex& index, const optional<Rect>& rect, size_t count, auto is_visible) {
+        vector<size_t> ids;
+        if (rect) {
+            vector<bool> seen(count);
+            index.Query(*rect, [&](uint32_t id) {
+                if (!seen[id]) {
+                    seen[id] = true;
+                    ids.push_back(id);
+                }
+            });
+            sort(ids.begin(), ids.end());
+        } else {
+            // Проекция вырождена (все остановки в одной точке): отсекать нечего
+            ids.resize(count);
+            iota(ids.begin(), ids.end(), 0);
+        }
+        ids.erase(remove_if(ids.begin(), ids.end(), [&](size_t id) { return !is_visible(id); }), ids.end());
+        return ids;
+    };
+
+    const vector<size_t> bus_ids = collect(layout.bus_index, query, layout.buses.size(), bus_visible);
+    const vector<size_t> stop_ids = collect(layout.stop_index, query, layout.stops.size(), stop_visible);
+
+    std::string svg;
+    svg::Writer writer(svg);
+    RenderLayers(writer, layout, bus_ids, stop_ids, view);
+    return svg;
+}
+
+const MapRenderer::RouteShapes* MapRenderer::GetRouteShapes(const Layout& layout,
+                                                             const SphereProjector& view) const {
+    const double base_zoom = layout.projector.GetZoom();
+    if (!(render_settings_.simplify_tolerance > 0) || IsZero(base_zoom)) {
+        return nullptr;
+    }
+
+    // Уровень округляется вверх: на нём точки не реже, чем нужно виду
+    const int level = std::clamp(static_cast<int>(std::ceil(std::log2(view.GetZoom() / base_zoom) - EPSILON)),
+                                 0, MAX_DETAIL_LEVEL);
+    if (layout.route_shapes.size() <= static_cast<size_t>(level)) {
+        layout.route_shapes.resize(level + 1);
+    }
+    auto& shapes = layout.route_shapes[level];
+    if (!shapes) {
+        TRACE_SCOPE_ARG("MapRenderer::SimplifyRoutes", "level", level);
+        // Упрощение не зависит от сдвига вида, поэтому считается в пикселях всей
+        // карты с допуском, уменьшенным во столько же раз, во сколько увеличен уровень
+        const double tolerance = std::ldexp(render_settings_.simplify_tolerance, -level);
+        shapes.emplace();
+        shapes->reserve(layout.buses.size());
+        vector<svg::Point> points;
+        for (const auto* bus : layout.buses) {
+            points.clear();
+            for (const auto* stop : bus->stops) {
+                points.push_back(layout.projector(stop->coordinates));
+            }
+            shapes->push_back(SimplifyPolyline(points, tolerance));
+        }
+    }
+    return &*shapes;
+}
+
+const MapRenderer::Layout& MapRenderer::GetLayout() const {
+    const uint64_t version = catalogue_.GetVersion();
+    if (layout_ && layout_->catalogue_version == version) {
+        return *layout_;
+    }
+    TRACE_SCOPE("MapRenderer::GetLayout");
+
+    vector<const transport_catalogue::Bus*> buses = GetSortedNonEmptyBuses();
+    vector<const transport_catalogue::Stop*> stops = GetSortedBusStops();
+
+    vector<Coordinates> coordinates;
+    coordinates.reserve(stops.size());
+    for (const auto* stop : stops) {
+        coordinates.push_back(stop->coordinates);
+    }
+    SphereProjector projector = CreateProjector(coordinates.begin(), coordinates.end());
+
+    Rect bounds;
+    if (!coordinates.empty()) {
+        bounds = GeoBox(coordinates.front(), coordinates.front());
+        for (const auto& coords : coordinates) {
+            bounds = {std::min(bounds.min_x, coords.lng), std::min(bounds.min_y, coords.lat),
+                      std::max(bounds.max_x, coords.lng), std::max(bounds.max_y, coords.lat)};
+        }
+    }
+    // Около двух остановок на ячейку
+    const size_t cells_per_side = std::clamp<size_t>(
+        static_cast<size_t>(std::sqrt(static_cast<double>(stops.size()) / 2)), 1, 256);
+
+    GridIndex bus_index(bounds, cells_per_side);
+    size_t max_bus_name_length = 0;
+    for (size_t id = 0; id < buses.size(); ++id) {
+        const auto& bus_stops = buses[id]->stops;
+        for (size_t i = 0; i < bus_stops.size(); ++i) {
+            const auto* next = bus_stops[i + 1 < bus_stops.size() ? i + 1 : i];
+            bus_index.Insert(static_cast<uint32_t>(id), GeoBox(bus_stops[i]->coordinates, next->coordinates));
+        }
+        max_bus_name_length = std::max(max_bus_name_length, buses[id]->name.size());
+    }
+
+    GridIndex stop_index(bounds, cells_per_side);
+    size_t max_stop_name_length = 0;
+    for (size_t id = 0; id < stops.size(); ++id) {
+        stop_index.Insert(static_cast<uint32_t>(id), GeoBox(stops[id]->coordinates, stops[id]->coordinates));
+        max_stop_name_length = std::max(max_stop_name_length, stops[id]->name.size());
+    }
+
+    layout_.emplace(Layout{version, projector, std::move(buses), std::move(stops),
+                           std::move(bus_index), std::move(stop_index),
+                           max_bus_name_length, max_stop_name_length, {}});
+    return *layout_;
+}
+
+template <typename PointInputIt>
+SphereProjector MapRenderer::CreateProjector(PointInputIt points_begin, PointInputIt points_end) const {
+    return SphereProjector(points_begin, points_end,
                            render_settings_.width,
                            render_settings_.height,
                            render_settings_.padding);
@@ -126,117 +776,144 @@ vector<const transport_catalogue::Stop*> MapRenderer::GetSortedBusStops() const
     return sortedStops;
 }
 
-void MapRenderer::RenderBusRoutes(svg::Document& doc,
+void MapRenderer::RenderBusRoutes(svg::Writer& writer,
                                   const vector<const transport_catalogue::Bus*>& buses,
+                                  span<const size_t> bus_ids,
+                                  const RouteShapes* shapes,
                                   const SphereProjector& projector) const {
-    for (size_t i = 0; i < buses.size(); ++i) {
+    for (size_t i : bus_ids) {
         const auto* bus = buses[i];
-        svg::Polyline polyline;
-        polyline.SetStrokeColor(render_settings_.color_palette[i % render_settings_.color_palette.size()])
-               .SetFillColor("none")
-               .SetStrokeWidth(render_settings_.line_width)
-               .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-               .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-
-        for (const auto* stop : bus->stops) {
-            polyline.AddPoint(projector(stop->coordinates));
-        }
-        if (!bus->is_roundtrip) {
-            for (auto it = bus->stops.rbegin() + 1; it != bus->stops.rend(); ++it) {
-                polyline.AddPoint(projector((*it)->coordinates));
+        writer.BeginPolyline();
+        if (shapes) {
+            const auto& kept = (*shapes)[i];
+            for (uint32_t index : kept) {
+                writer.AddPolylinePoint(projector(bus->stops[index]->coordinates));
+            }
+            if (!bus->is_roundtrip) {
+                for (auto it = kept.rbegin() + 1; it != kept.rend(); ++it) {
+                    writer.AddPolylinePoint(projector(bus->stops[*it]->coordinates));
+                }
+            }
+        } else {
+            for (const auto* stop : bus->stops) {
+                writer.AddPolylinePoint(projector(stop->coordinates));
             }
+            if (!bus->is_roundtrip) {
+                for (auto it = bus->stops.rbegin() + 1; it != bus->stops.rend(); ++it) {
+                    writer.AddPolylinePoint(projector((*it)->coordinates));
+                }
+            }
+        }
+
+        const size_t color_index = i % render_settings_.color_palette.size();
+        svg::PathStyle style;
+        if (style_classes_) {
+            style.class_name = style_classes_->routes[color_index];
+        } else {
+            style.fill_color = &NONE_COLOR;
+            style.stroke_color = &render_settings_.color_palette[color_index];
+            style.stroke_width = render_settings_.line_width;
+            style.stroke_linecap = svg::StrokeLineCap::ROUND;
+            style.stroke_linejoin = svg::StrokeLineJoin::ROUND;
         }
-        doc.Add(std::move(polyline));
+        writer.EndPolyline(style);
     }
 }
 
-void MapRenderer::RenderBusLabels(svg::Document& doc,
+void MapRenderer::RenderBusLabels(svg::Writer& writer,
                                   const vector<const transport_catalogue::Bus*>& buses,
+                                  span<const size_t> bus_ids,
                                   const SphereProjector& projector) const {
-    for (size_t i = 0; i < buses.size(); ++i) {
+    for (size_t i : bus_ids) {
         const auto* bus = buses[i];
         if (bus->stops.empty()) continue;
 
-        const auto& color = render_settings_.color_palette[i % render_settings_.color_palette.size()];
-        RenderBusLabelForStop(doc, bus, bus->stops.front(), color, projector);
+        const size_t color_index = i % render_settings_.color_palette.size();
+        RenderBusLabelForStop(writer, bus, bus->stops.front(), color_index, projector);
 
         if (!bus->is_roundtrip && bus->stops.front() != bus->stops.back()) {
-            RenderBusLabelForStop(doc, bus, bus->stops.back(), color, projector);
+            RenderBusLabelForStop(writer, bus, bus->stops.back(), color_index, projector);
         }
     }
 }
 
-void MapRenderer::RenderBusLabelForStop(svg::Document& doc,
+void MapRenderer::RenderBusLabelForStop(svg::Writer& writer,
                                         const transport_catalogue::Bus* bus,
                                         const transport_catalogue::Stop* stop,
-                                        const svg::Color& color,
+                                        size_t color_index,
                                         const SphereProjector& projector) const {
-    auto point = projector(stop->coordinates);
-
-    svg::Text underlayer;
-    underlayer.SetFillColor(render_settings_.underlayer_color)
-             .SetStrokeColor(render_settings_.underlayer_color)
-             .SetStrokeWidth(render_settings_.underlayer_width)
-             .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-             .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND)
-             .SetPosition(point)
-             .SetOffset({render_settings_.bus_label_offset.first, render_settings_.bus_label_offset.second})
-             .SetFontSize(render_settings_.bus_label_font_size)
-             .SetFontFamily("Verdana")
-             .SetFontWeight("bold")
-             .SetData(bus->name);
-    doc.Add(std::move(underlayer));
-
-    svg::Text text;
-    text.SetFillColor(color)
-        .SetPosition(point)
-        .SetOffset({render_settings_.bus_label_offset.first, render_settings_.bus_label_offset.second})
-        .SetFontSize(render_settings_.bus_label_font_size)
-        .SetFontFamily("Verdana")
-        .SetFontWeight("bold")
-        .SetData(bus->name);
-    doc.Add(std::move(text));
-}
-
-void MapRenderer::RenderStopCircles(svg::Document& doc,
+    svg::TextProps text;
+    text.position = projector(stop->coordinates);
+    text.offset = {render_settings_.bus_label_offset.first, render_settings_.bus_label_offset.second};
+    text.data = bus->name;
+
+    svg::PathStyle underlayer_style;
+    svg::PathStyle style;
+    if (style_classes_) {
+        text.font_size = nullopt;
+        underlayer_style.class_name = "bl u"sv;
+        style.class_name = style_classes_->bus_labels[color_index];
+    } else {
+        text.font_size = render_settings_.bus_label_font_size;
+        text.font_family = "Verdana"sv;
+        text.font_weight = "bold"sv;
+        underlayer_style = UnderlayerStyle();
+        style.fill_color = &render_settings_.color_palette[color_index];
+    }
+    writer.WriteText(text, underlayer_style);
+    writer.WriteText(text, style);
+}
+
+void MapRenderer::RenderStopCircles(svg::Writer& writer,
                                     const vector<const transport_catalogue::Stop*>& stops,
+                                    span<const size_t> stop_ids,
                                     const SphereProjector& projector) const {
-    for (const auto* stop : stops) {
-        auto point = projector(stop->coordinates);
-        svg::Circle circle;
-        circle.SetCenter(point)
-              .SetRadius(render_settings_.stop_radius)
-              .SetFillColor("white");
-        doc.Add(std::move(circle));
+    svg::PathStyle style;
+    if (style_classes_) {
+        style.class_name = "sc"sv;
+    } else {
+        style.fill_color = &WHITE_COLOR;
+    }
+    for (size_t i : stop_ids) {
+        const auto* stop = stops[i];
+        writer.WriteCircle(projector(stop->coordinates), render_settings_.stop_radius, style);
     }
 }
 
-void MapRenderer::RenderStopLabels(svg::Document& doc,
+void MapRenderer::RenderStopLabels(svg::Writer& writer,
                                    const vector<const transport_catalogue::Stop*>& stops,
+                                   span<const size_t> stop_ids,
                                    const SphereProjector& projector) const {
-    for (const auto* stop : stops) {
-        auto point = projector(stop->coordinates);
-
-        svg::Text underlayer;
-        underlayer.SetFillColor(render_settings_.underlayer_color)
-                 .SetStrokeColor(render_settings_.underlayer_color)
-                 .SetStrokeWidth(render_settings_.underlayer_width)
-                 .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-                 .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND)
-                 .SetPosition(point)
-                 .SetOffset({render_settings_.stop_label_offset.first, render_settings_.stop_label_offset.second})
-                 .SetFontSize(render_settings_.stop_label_font_size)
-                 .SetFontFamily("Verdana")
-                 .SetData(stop->name);
-        doc.Add(std::move(underlayer));
-
-        svg::Text text;
-        text.SetFillColor("black")
-            .SetPosition(point)
-            .SetOffset({render_settings_.stop_label_offset.first, render_settings_.stop_label_offset.second})
-            .SetFontSize(render_settings_.stop_label_font_size)
-            .SetFontFamily("Verdana")
-            .SetData(stop->name);
-        doc.Add(std::move(text));
-    }
-}
\ No newline at end of file
+    svg::PathStyle underlayer_style;
+    svg::PathStyle style;
+    svg::TextProps text;
+    text.offset = {render_settings_.stop_label_offset.first, render_settings_.stop_label_offset.second};
+    if (style_classes_) {
+        underlayer_style.class_name = "sl u"sv;
+        style.class_name = "sl k"sv;
+        text.font_size = nullopt;
+    } else {
+        underlayer_style = UnderlayerStyle();
+        style.fill_color = &BLACK_COLOR;
+        text.font_size = render_settings_.stop_label_font_size;
+        text.font_family = "Verdana"sv;
+    }
+    for (size_t i : stop_ids) {
+        const auto* stop = stops[i];
+        text.position = projector(stop->coordinates);
+        text.data = stop->name;
+
+        writer.WriteText(text, underlayer_style);
+        writer.WriteText(text, style);
+    }
+}
+
+svg::PathStyle MapRenderer::UnderlayerStyle() const {
+    svg::PathStyle style;
+    style.fill_color = &render_settings_.underlayer_color;
+    style.stroke_color = &render_settings_.underlayer_color;
+    style.stroke_width = render_settings_.underlayer_width;
+    style.stroke_linecap = svg::StrokeLineCap::ROUND;
+    style.stroke_linejoin = svg::StrokeLineJoin::ROUND;
+    return style;
+}
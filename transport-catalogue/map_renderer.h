@@ -3,6 +3,13 @@
 #include "transport_catalogue.h"
 #include "svg.h"
 #include "geo.h"
+#include "spatial_index.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -23,8 +30,52 @@ struct RenderSettings {
     double underlayer_width;
     
     std::vector<svg::Color> color_palette;
+
+    // Допуск упрощения линий маршрутов в пикселях; 0 — линии выводятся без упрощения
+    double simplify_tolerance = 0;
+
+    // Общие атрибуты выносятся в таблицу стилей, элементы ссылаются на классы
+    bool style_classes = false;
+
+    // Знаков после точки в координатах; без значения — как ostream << double
+    std::optional<int> coordinate_precision;
+
+    bool operator==(const RenderSettings&) const = default;
+};
+
+// Тайл карты: на уровне zoom вся карта делится на 2^zoom × 2^zoom тайлов,
+// и каждый рисуется в полный размер width × height
+struct MapTile {
+    int zoom = 0;
+    int x = 0;
+    int y = 0;
+};
+
+// Область карты в географических координатах
+struct GeoBounds {
+    Coordinates min;
+    Coordinates max;
 };
 
+// Поездка маршрута для наложения на карту: span_count перегонов автобуса bus
+// от остановки bus->stops[first_stop_index], вперёд или назад по списку
+struct RouteLeg {
+    const transport_catalogue::Bus* bus = nullptr;
+    size_t first_stop_index = 0;
+    size_t span_count = 0;
+    bool backward = false;
+};
+
+// Остановка изохроны и время, за которое до неё можно доехать
+struct IsochroneStop {
+    const transport_catalogue::Stop* stop = nullptr;
+    double time = 0;
+};
+
+// Хэш всех полей настроек: карта, построенная с равными настройками, совпадает.
+// Равные хэши ещё не значат равных настроек
+size_t HashRenderSettings(const RenderSettings& settings);
+
 
 class SphereProjector {
 public:
@@ -34,8 +85,23 @@ public:
 
     svg::Point operator()(Coordinates coords) const;
 
+    bool operator==(const SphereProjector& other) const = default;
+
+    double GetZoom() const {
+        return zoom_coeff_;
+    }
+
+    // Та же проекция, увеличенная в scale раз и сдвинутая так,
+    // что точка origin исходной проекции попадает в начало координат
+    SphereProjector Scaled(double scale, svg::Point origin) const;
+
+    // Географический прямоугольник (x — долгота, y — широта), который проецируется
+    // в прямоугольник rect; nullopt, если проекция вырождена в точку
+    std::optional<Rect> Unproject(const Rect& rect) const;
+
 private:
-    double padding_;
+    double offset_x_;
+    double offset_y_;
     double min_lon_ = 0;
     double max_lat_ = 0;
     double zoom_coeff_ = 0;
@@ -46,39 +112,145 @@ public:
     MapRenderer(const transport_catalogue::TransportCatalogue& catalogue,
                 const RenderSettings& render_settings);
 
-    void Render(svg::Document& doc) const;
+    // Пишет SVG всей карты сразу в буфер writer
+    void Render(svg::Writer& writer) const;
+
+    // SVG всей карты. Рендерится один раз и переиспользуется,
+    // пока версия каталога не изменилась
+    const std::string& GetMapSvg() const;
+
+    // Фрагменты карты. Выводятся только линии, подписи и остановки, которые
+    // задевают область; они ищутся по пространственному индексу, так что время
+    // и размер ответа зависят от видимой части, а не от размера всей сети
+    std::string RenderTile(const MapTile& tile) const;
+    std::string RenderBounds(const GeoBounds& bounds) const;
+
+    // Полная карта с наложенным маршрутом. Берётся закэшированная карта,
+    // заново рендерится только слой поездок
+    std::string RenderRouteMap(std::span<const RouteLeg> legs) const;
+
+    // Полная карта с изохроной: поверх закэшированной карты остановки закрашены
+    // от зелёного (сразу) до красного (за max_time)
+    std::string RenderIsochroneMap(std::span<const IsochroneStop> stops, double max_time) const;
+
+    size_t GetSettingsHash() const {
+        return settings_hash_;
+    }
+    const RenderSettings& GetSettings() const {
+        return render_settings_;
+    }
 
 private:
+    struct CachedMap {
+        uint64_t catalogue_version;
+        std::string svg;
+    };
+
     const transport_catalogue::TransportCatalogue& catalogue_;
     RenderSettings render_settings_;
+    size_t settings_hash_;
+    mutable std::optional<CachedMap> cached_map_;
+
+    // Таблица стилей и классы для режима style_classes; классы с цветом
+    // построены для каждого цвета палитры
+    struct StyleClasses {
+        std::string style_sheet;
+        std::vector<std::string> routes;
+        std::vector<std::string> bus_labels;
+    };
+    std::optional<StyleClasses> style_classes_;
+
+    static StyleClasses MakeStyleClasses(const RenderSettings& settings);
+
+    // Фрагменты полной карты по каждому автобусу и остановке. Пока проекция
+    // не меняется, после изменения каталога рендерятся заново только новые объекты
+    // и автобусы, которым из-за нового порядка достался другой цвет палитры
+    struct BusFragments {
+        size_t color_index;
+        std::string route;
+        std::string labels;
+    };
+    struct StopFragments {
+        std::string circle;
+        std::string label;
+    };
+    struct MapFragments {
+        SphereProjector projector;
+        std::unordered_map<const transport_catalogue::Bus*, BusFragments> buses;
+        std::unordered_map<const transport_catalogue::Stop*, StopFragments> stops;
+    };
+    mutable std::optional<MapFragments> fragments_;
 
-    std::vector<Coordinates> CollectAllCoordinates() const;
+    using RouteShapes = std::vector<std::vector<uint32_t>>;
 
-    SphereProjector CreateProjector(const std::vector<Coordinates>& coordinates) const;
+    // Всё, что зависит только от содержимого каталога: проекция всей карты,
+    // порядок вывода и пространственные индексы в географических координатах
+    struct Layout {
+        uint64_t catalogue_version;
+        SphereProjector projector;
+        std::vector<const transport_catalogue::Bus*> buses;
+        std::vector<const transport_catalogue::Stop*> stops;
+        GridIndex bus_index;   // отрезки маршрутов, идентификатор — номер в buses
+        GridIndex stop_index;  // номер в stops
+        size_t max_bus_name_length;
+        size_t max_stop_name_length;
+        // Упрощённые линии по уровням детализации: для каждого автобуса — номера
+        // оставшихся остановок в bus->stops. Уровень z соответствует увеличению
+        // до 2^z раз относительно всей карты, считается при первом обращении
+        mutable std::vector<std::optional<RouteShapes>> route_shapes;
+    };
+    mutable std::optional<Layout> layout_;
+
+    const Layout& GetLayout() const;
+
+    void UpdateFragments(const Layout& layout) const;
+
+    // Упрощённые линии для вида view или nullptr, если упрощение выключено
+    const RouteShapes* GetRouteShapes(const Layout& layout, const SphereProjector& view) const;
+
+    template <typename PointInputIt>
+    SphereProjector CreateProjector(PointInputIt points_begin, PointInputIt points_end) const;
 
     std::vector<const transport_catalogue::Bus*> GetSortedNonEmptyBuses() const;
 
     std::vector<const transport_catalogue::Stop*> GetSortedBusStops() const;
 
-    void RenderBusRoutes(svg::Document& doc,
+    std::string RenderView(const Layout& layout, const SphereProjector& view) const;
+
+    // Выводит слои карты для выбранных автобусов и остановок (номера в layout.buses
+    // и layout.stops по возрастанию); цвет автобуса определяется его номером.
+    // Большие карты рендерятся кусками в нескольких потоках, порядок вывода сохраняется
+    void RenderLayers(svg::Writer& writer, const Layout& layout,
+                      const std::vector<size_t>& bus_ids,
+                      const std::vector<size_t>& stop_ids,
+                      const SphereProjector& projector) const;
+
+    void RenderBusRoutes(svg::Writer& writer,
                          const std::vector<const transport_catalogue::Bus*>& buses,
+                         std::span<const size_t> bus_ids,
+                         const RouteShapes* shapes,
                          const SphereProjector& projector) const;
 
-    void RenderBusLabels(svg::Document& doc,
+    void RenderBusLabels(svg::Writer& writer,
                          const std::vector<const transport_catalogue::Bus*>& buses,
+                         std::span<const size_t> bus_ids,
                          const SphereProjector& projector) const;
 
-    void RenderBusLabelForStop(svg::Document& doc,
+    void RenderBusLabelForStop(svg::Writer& writer,
                                const transport_catalogue::Bus* bus,
                                const transport_catalogue::Stop* stop,
-                               const svg::Color& color,
+                               size_t color_index,
                                const SphereProjector& projector) const;
 
-    void RenderStopCircles(svg::Document& doc,
+    void RenderStopCircles(svg::Writer& writer,
                            const std::vector<const transport_catalogue::Stop*>& stops,
+                           std::span<const size_t> stop_ids,
                            const SphereProjector& projector) const;
 
-    void RenderStopLabels(svg::Document& doc,
+    void RenderStopLabels(svg::Writer& writer,
                           const std::vector<const transport_catalogue::Stop*>& stops,
+                          std::span<const size_t> stop_ids,
                           const SphereProjector& projector) const;
+
+    svg::PathStyle UnderlayerStyle() const;
 };
\ No newline at end of file
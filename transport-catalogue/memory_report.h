@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace memory {
+
+// Оценка памяти, занятой структурами данных, по частям. Считается по размерам
+// элементов и ёмкостям контейнеров, без служебных данных аллокатора
+struct MemoryReport {
+    std::vector<std::pair<std::string, size_t>> items;
+
+    void Add(std::string name, size_t bytes) {
+        items.emplace_back(std::move(name), bytes);
+    }
+
+    void Append(const MemoryReport& other) {
+        items.insert(items.end(), other.items.begin(), other.items.end());
+    }
+
+    size_t GetTotal() const {
+        size_t total = 0;
+        for (const auto& [name, bytes] : items) {
+            total += bytes;
+        }
+        return total;
+    }
+};
+
+// Куча строки; короткие строки хранятся в самом объекте
+inline size_t HeapBytes(const std::string& str) {
+    return str.capacity() > std::string().capacity() ? str.capacity() + 1 : 0;
+}
+
+template <typename T>
+size_t HeapBytes(const std::vector<T>& vec) {
+    return vec.capacity() * sizeof(T);
+}
+
+// Блоки deque по 512 байт и массив указателей на них
+template <typename T>
+size_t HeapBytes(const std::deque<T>& deq) {
+    constexpr size_t BLOCK_BYTES = 512;
+    const size_t per_block = sizeof(T) < BLOCK_BYTES ? BLOCK_BYTES / sizeof(T) : 1;
+    const size_t blocks = (deq.size() + per_block - 1) / per_block;
+    return blocks * std::max(BLOCK_BYTES, sizeof(T)) + (blocks + 8) * sizeof(void*);
+}
+
+// Узлы хэш-таблицы (указатель на следующий, значение и сохранённый хэш) и массив корзин
+template <typename Container>
+size_t HashTableBytes(const Container& container) {
+    const size_t node = sizeof(void*) + sizeof(typename Container::value_type) + sizeof(size_t);
+    return container.size() * node + container.bucket_count() * sizeof(void*);
+}
+
+}  // namespace memory
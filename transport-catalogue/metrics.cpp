@@ -0,0 +1,219 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cmath>
+
+#include <sys/resource.h>
+
+namespace metrics {
+
+namespace {
+
+// Включённых Recorder'ов; пока их нет, operator new не трогает счётчик
+std::atomic<int> active_recorders{0};
+std::atomic<uint64_t> allocation_count{0};
+
+// Счётчики больше int выводятся как double
+json::Node CountToJson(uint64_t count) {
+    if (count <= static_cast<uint64_t>(INT_MAX)) {
+        return static_cast<int>(count);
+    }
+    return static_cast<double>(count);
+}
+
+double Microseconds(std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Номер корзины: значения меньше 2 * SUB_BUCKET_COUNT лежат каждое в своей корзине,
+// большие сдвигаются так, чтобы осталось SUB_BUCKET_COUNT..2 * SUB_BUCKET_COUNT - 1
+size_t BucketIndex(uint64_t value) {
+    constexpr uint64_t SUB = LatencyHistogram::SUB_BUCKET_COUNT;
+    constexpr int SUB_BITS = std::countr_zero(SUB);
+    if (value < 2 * SUB) {
+        return static_cast<size_t>(value);
+    }
+    const int shift = std::bit_width(value) - 1 - SUB_BITS;
+    return static_cast<size_t>(SUB * static_cast<uint64_t>(shift) + (value >> shift));
+}
+
+// Наибольшее значение, попадающее в корзину index
+uint64_t BucketUpperBound(size_t index) {
+    constexpr uint64_t SUB = LatencyHistogram::SUB_BUCKET_COUNT;
+    if (index < 2 * SUB) {
+        return index;
+    }
+    const uint64_t shift = index / SUB - 1;
+    const uint64_t mantissa = index - SUB * shift;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+}  // namespace
+
+void LatencyHistogram::Record(std::chrono::nanoseconds duration) {
+    const auto value = static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 0));
+    const size_t index = BucketIndex(value);
+    if (index >= buckets_.size()) {
+        buckets_.resize(index + 1);
+    }
+    ++buckets_[index];
+    ++count_;
+    total_ += value;
+    max_ = std::max(max_, value);
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetPercentile(double percentile) const {
+    if (count_ == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    // Ранг — номер значения по возрастанию, начиная с 1
+    const auto rank = std::clamp<uint64_t>(
+        static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 1.0) * static_cast<double>(count_))),
+        1, count_);
+    uint64_t seen = 0;
+    for (size_t index = 0; index < buckets_.size(); ++index) {
+        seen += buckets_[index];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds(std::min(BucketUpperBound(index), max_));
+        }
+    }
+    return std::chrono::nanoseconds(max_);
+}
+
+json::Node LatencyHistogram::ToJson() const {
+    json::Dict result;
+    result.emplace("count", CountToJson(count_));
+    result.emplace("mean_us", count_ ? static_cast<double>(total_) / static_cast<double>(count_) / 1000 : 0.0);
+    result.emplace("p50_us", Microseconds(GetPercentile(0.5)));
+    result.emplace("p90_us", Microseconds(GetPercentile(0.9)));
+    result.emplace("p99_us", Microseconds(GetPercentile(0.99)));
+    result.emplace("max_us", Microseconds(GetMax()));
+    return result;
+}
+
+void RequestLatencies::Record(std::string_view type, std::optional<int> request_id,
+                              std::chrono::nanoseconds duration) {
+    auto it = histograms_.find(type);
+    if (it == histograms_.end()) {
+        it = histograms_.emplace(std::string(type), LatencyHistogram{}).first;
+    }
+    it->second.Record(duration);
+
+    if (slowest_count_ == 0) {
+        return;
+    }
+    auto faster = [](const SlowRequest& lhs, const SlowRequest& rhs) {
+        return lhs.duration > rhs.duration;
+    };
+    if (slowest_.size() == slowest_count_) {
+        if (duration <= slowest_.front().duration) {
+            return;
+        }
+        std::pop_heap(slowest_.begin(), slowest_.end(), faster);
+        slowest_.pop_back();
+    }
+    slowest_.push_back({duration, request_id, std::string(type)});
+    std::push_heap(slowest_.begin(), slowest_.end(), faster);
+}
+
+json::Node RequestLatencies::ToJson() const {
+    json::Dict by_type;
+    for (const auto& [type, histogram] : histograms_) {
+        by_type.emplace(type, histogram.ToJson());
+    }
+
+    std::vector<const SlowRequest*> sorted;
+    sorted.reserve(slowest_.size());
+    for (const auto& request : slowest_) {
+        sorted.push_back(&request);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const SlowRequest* lhs, const SlowRequest* rhs) {
+        return lhs->duration > rhs->duration;
+    });
+    json::Array slowest;
+    for (const auto* request : sorted) {
+        json::Dict item;
+        item.emplace("request_id", request->request_id ? json::Node(*request->request_id) : json::Node(nullptr));
+        item.emplace("type", request->type);
+        item.emplace("us", Microseconds(request->duration));
+        slowest.push_back(std::move(item));
+    }
+
+    json::Dict result;
+    result.emplace("by_type", std::move(by_type));
+    result.emplace("slowest", std::move(slowest));
+    return result;
+}
+
+void CountAllocation() {
+    if (active_recorders.load(std::memory_order_relaxed) > 0) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t GetAllocationCount() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+long GetPeakRssKb() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+Recorder::Recorder(bool enabled)
+    : enabled_(enabled) {
+    if (enabled_) {
+        active_recorders.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Recorder::~Recorder() {
+    if (enabled_) {
+        active_recorders.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void Recorder::SetCount(std::string name, uint64_t count) {
+    if (enabled_) {
+        counts_[name] = CountToJson(count);
+    }
+}
+
+void Recorder::AddMemoryReport(const memory::MemoryReport& report) {
+    if (enabled_) {
+        memory_.Append(report);
+    }
+}
+
+json::Document Recorder::ToJson() const {
+    json::Array phases;
+    phases.reserve(phases_.size());
+    for (const auto& phase : phases_) {
+        json::Dict item;
+        item.emplace("name", phase.name);
+        item.emplace("wall_ms", phase.wall_ms);
+        item.emplace("peak_rss_kb", CountToJson(static_cast<uint64_t>(phase.peak_rss_kb)));
+        item.emplace("peak_rss_delta_kb", CountToJson(static_cast<uint64_t>(phase.peak_rss_delta_kb)));
+        item.emplace("allocations", CountToJson(phase.allocations));
+        phases.push_back(std::move(item));
+    }
+    json::Dict result;
+    result.emplace("phases", std::move(phases));
+    result.emplace("counts", counts_);
+    json::Dict memory;
+    for (const auto& [name, bytes] : memory_.items) {
+        memory.emplace(name, CountToJson(bytes));
+    }
+    memory.emplace("total", CountToJson(memory_.GetTotal()));
+    result.emplace("memory", std::move(memory));
+    result.emplace("requests", latencies_.ToJson());
+    return json::Document(std::move(result));
+}
+
+}  // namespace metrics
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "json.h"
+#include "memory_report.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace metrics {
+
+// Число вызовов operator new с начала работы программы. Аллокации считаются,
+// только пока включён хотя бы один Recorder, и только в программе, где
+// operator new заменён (allocation_counter.cpp); в остальных счётчик равен 0
+uint64_t GetAllocationCount();
+
+// Отмечает одну аллокацию; вызывается заменённым operator new
+void CountAllocation();
+
+// Пиковый размер резидентной памяти процесса в килобайтах (getrusage)
+long GetPeakRssKb();
+
+// Гистограмма задержек в стиле HDR: значения до 2 * SUB_BUCKET_COUNT нс хранятся
+// точно, дальше каждый интервал [2^k, 2^(k+1)) делится на SUB_BUCKET_COUNT корзин,
+// так что относительная ошибка перцентилей не больше 1 / SUB_BUCKET_COUNT
+class LatencyHistogram {
+public:
+    static constexpr uint64_t SUB_BUCKET_COUNT = 64;
+
+    void Record(std::chrono::nanoseconds duration);
+
+    uint64_t GetCount() const {
+        return count_;
+    }
+
+    // Верхняя граница корзины, в которую попал перцентиль percentile (от 0 до 1),
+    // но не больше максимума
+    std::chrono::nanoseconds GetPercentile(double percentile) const;
+
+    std::chrono::nanoseconds GetMax() const {
+        return std::chrono::nanoseconds(max_);
+    }
+
+    // {"count", "mean_us", "p50_us", "p90_us", "p99_us", "max_us"}
+    json::Node ToJson() const;
+
+private:
+    std::vector<uint64_t> buckets_;
+    uint64_t count_ = 0;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+};
+
+// Задержки запросов по типам и самые медленные запросы с их id
+class RequestLatencies {
+public:
+    static constexpr size_t DEFAULT_SLOWEST_COUNT = 10;
+
+    explicit RequestLatencies(size_t slowest_count = DEFAULT_SLOWEST_COUNT)
+        : slowest_count_(slowest_count) {}
+
+    void Record(std::string_view type, std::optional<int> request_id, std::chrono::nanoseconds duration);
+
+    // {"by_type": {type: гистограмма}, "slowest": [{"request_id", "type", "us"}, ..]},
+    // самые медленные идут первыми
+    json::Node ToJson() const;
+
+private:
+    struct SlowRequest {
+        std::chrono::nanoseconds duration;
+        std::optional<int> request_id;
+        std::string type;
+    };
+
+    size_t slowest_count_;
+    std::map<std::string, LatencyHistogram, std::less<>> histograms_;
+    // Куча с самым быстрым из запомненных запросов на вершине
+    std::vector<SlowRequest> slowest_;
+};
+
+// Метрики этапов работы программы. Выключенный Recorder только вызывает
+// переданные функции и ничего не измеряет
+class Recorder {
+public:
+    explicit Recorder(bool enabled);
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    bool IsEnabled() const {
+        return enabled_;
+    }
+
+    // Выполняет phase() и запоминает для этапа name время, прирост пикового RSS
+    // и число аллокаций. Этап также отмечается интервалом трассировки
+    template <typename Phase>
+    void Measure(std::string name, Phase&& phase);
+
+    // Счётчик в отчёте, например размер графа
+    void SetCount(std::string name, uint64_t count);
+
+    // Оценка памяти по частям; несколько отчётов объединяются
+    void AddMemoryReport(const memory::MemoryReport& report);
+
+    // Задержки отдельных запросов или nullptr, если Recorder выключен
+    RequestLatencies* GetRequestLatencies() {
+        return enabled_ ? &latencies_ : nullptr;
+    }
+
+    // {"phases": [{"name", "wall_ms", "peak_rss_kb", "peak_rss_delta_kb", "allocations"}, ..],
+    //  "counts": {..}, "memory": {часть: байт, .., "total": ..}, "requests": {..}}
+    json::Document ToJson() const;
+
+private:
+    struct PhaseMetrics {
+        std::string name;
+        double wall_ms;
+        long peak_rss_kb;
+        long peak_rss_delta_kb;
+        uint64_t allocations;
+    };
+
+    bool enabled_;
+    std::vector<PhaseMetrics> phases_;
+    json::Dict counts_;
+    memory::MemoryReport memory_;
+    RequestLatencies latencies_;
+};
+
+template <typename Phase>
+void Recorder::Measure(std::string name, Phase&& phase) {
+    TRACE_SCOPE(name);
+    if (!enabled_) {
+        phase();
+        return;
+    }
+    using Clock = std::chrono::steady_clock;
+    const long rss_before = GetPeakRssKb();
+    const uint64_t allocations_before = GetAllocationCount();
+    const auto start = Clock::now();
+
+    phase();
+
+    const auto wall = std::chrono::duration<double, std::milli>(Clock::now() - start);
+    const uint64_t allocations = GetAllocationCount() - allocations_before;
+    const long rss_after = GetPeakRssKb();
+    phases_.push_back({std::move(name), wall.count(), rss_after, rss_after - rss_before, allocations});
+}
+
+}  // namespace metrics
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// Сколько потоков имеет смысл занять под count независимых элементов,
+// если каждому потоку должно достаться не меньше min_chunk элементов
+inline size_t ChooseThreadCount(size_t count, size_t min_chunk) {
+    const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    return std::clamp<size_t>(count / std::max<size_t>(min_chunk, 1), 1, hardware);
+}
+
+// Делит [0, count) на chunk_count непрерывных кусков почти равной длины и вызывает
+// func(chunk_index, begin, end) для каждого в отдельном потоке; первый кусок
+// обрабатывается вызывающим потоком. Первое из исключений кусков пробрасывается
+// после завершения всех потоков.
+template <typename Func>
+void ForEachChunk(size_t count, size_t chunk_count, Func func) {
+    chunk_count = std::clamp<size_t>(chunk_count, 1, std::max<size_t>(count, 1));
+    auto chunk_begin = [count, chunk_count](size_t chunk) {
+        return count * chunk / chunk_count;
+    };
+
+    std::vector<std::exception_ptr> errors(chunk_count);
+    auto run = [&](size_t chunk) {
+        try {
+            func(chunk, chunk_begin(chunk), chunk_begin(chunk + 1));
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunk_count - 1);
+    for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+        try {
+            threads.emplace_back(run, chunk);
+        } catch (const std::system_error&) {
+            // Не удалось создать поток — кусок обрабатывается на месте
+            run(chunk);
+        }
+    }
+    run(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}  // namespace parallel
@@ -0,0 +1,263 @@
+#include "query_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define QUERY_SERVER_UNIX_SOCKET
+#endif
+
+using namespace std::literals;
+
+namespace {
+
+bool IsBlank(std::string_view line) {
+    return line.find_first_not_of(" \t\r\n"sv) == std::string_view::npos;
+}
+
+std::string ErrorResponse(const json::Node* request_id, const std::string& message) {
+    json::Builder builder;
+    auto dict = builder.StartDict();
+    if (request_id) {
+        dict.Key("request_id").Value(request_id->GetValue());
+    }
+    dict.Key("error_message").Value(message);
+
+    std::ostringstream out;
+    json::Print(json::Document(dict.EndDict().Build()), out, json::PrintMode::COMPACT);
+    return out.str();
+}
+
+#ifdef QUERY_SERVER_UNIX_SOCKET
+// Строка запроса длиннее этого не дочитывается: клиенту отвечают ошибкой и
+// закрывают соединение, иначе клиент без '\n' занял бы сколько угодно памяти
+constexpr size_t MAX_SOCKET_LINE_SIZE = size_t{64} << 20;
+
+// Закрывает дескриптор при выходе из области видимости
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd)
+        : fd_(fd) {}
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    ~FileDescriptor() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    int Get() const {
+        return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+// Клиент может закрыть соединение раньше времени: SIGPIPE при этом не нужен
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+bool WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = send(fd, data.data(), data.size(), SEND_FLAGS);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+}
+#endif
+
+}  // namespace
+
+std::optional<CapturedRequest> ParseCapturedRequest(std::string_view log_line) {
+    const size_t tab = log_line.find('\t');
+    if (tab == std::string_view::npos || tab == 0) {
+        return std::nullopt;
+    }
+    int64_t arrival_us = 0;
+    const auto [end, error] = std::from_chars(log_line.data(), log_line.data() + tab, arrival_us);
+    if (error != std::errc{} || end != log_line.data() + tab) {
+        return std::nullopt;
+    }
+    return CapturedRequest{arrival_us, log_line.substr(tab + 1)};
+}
+
+void QueryServer::SetCapture(std::ostream& log) {
+    capture_ = &log;
+    capture_start_ = std::chrono::steady_clock::now();
+}
+
+std::string QueryServer::HandleLine(std::string_view line) {
+    if (capture_) {
+        const auto arrival = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - capture_start_);
+        // Перевод строки внутри запроса сломал бы журнал; в JSON он равен пробелу
+        std::string logged(line);
+        std::replace(logged.begin(), logged.end(), '\n', ' ');
+        *capture_ << arrival.count() << '\t' << logged << '\n';
+        // Сервер на сокете обычно останавливают сигналом, поэтому журнал сбрасывается сразу
+        capture_->flush();
+    }
+
+    // Задержка запроса включает его разбор; тип становится известен только после него
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    json::Document request_doc{nullptr};
+    try {
+        request_doc = json::Load(line);
+    } catch (const json::ParsingError& e) {
+        return ErrorResponse(nullptr, "invalid request: "s + e.what());
+    }
+
+    const json::Node& root = request_doc.GetRoot();
+    if (!root.IsDict()) {
+        return ErrorResponse(nullptr, "request must be an object"s);
+    }
+    const json::Dict& request = root.AsDict();
+    const auto id_it = request.find("id");
+    const json::Node* request_id = id_it != request.end() ? &id_it->second : nullptr;
+
+    try {
+        if (!latencies_) {
+            return ProcessRequest(request);
+        }
+        std::string response = ProcessRequest(request);
+        const auto& type = request.at("type");
+        latencies_->Record(type.IsString() ? type.AsString() : "?"s,
+                           request_id && request_id->IsInt() ? std::optional<int>(request_id->AsInt()) : std::nullopt,
+                           Clock::now() - start);
+        return response;
+    } catch (const std::exception& e) {
+        // Неполный запрос (нет id, type или нужных полей) не должен останавливать сервер
+        return ErrorResponse(request_id, "invalid request: "s + e.what());
+    }
+}
+
+std::string QueryServer::ProcessRequest(const json::Dict& request) {
+    json::Node response;
+    if (const auto type_it = request.find("type");
+        type_it != request.end() && type_it->second.IsString() && type_it->second.AsString() == "Update")
+    {
+        reader_.UpdateBase(request.at("base_requests").AsArray());
+        response = json::Builder{}.StartDict()
+            .Key("request_id").Value(request.at("id").AsInt())
+        .EndDict().Build();
+    } else {
+        response = reader_.ProcessStatRequest(request);
+    }
+
+    std::ostringstream out;
+    json::Print(json::Document(std::move(response)), out, json::PrintMode::COMPACT);
+    return out.str();
+}
+
+void QueryServer::Serve(std::istream& input, std::ostream& output) {
+    for (std::string line; std::getline(input, line);) {
+        if (IsBlank(line)) {
+            continue;
+        }
+        output << HandleLine(line) << '\n';
+        output.flush();
+    }
+}
+
+void QueryServer::ServeUnixSocket(const std::string& path) {
+#ifdef QUERY_SERVER_UNIX_SOCKET
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path is too long: "s + path);
+    }
+    path.copy(address.sun_path, path.size());
+
+    FileDescriptor listener(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.Get() < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    // Сокет, оставшийся от прежнего запуска, заменяется; любой другой файл — нет
+    struct stat existing{};
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            throw std::invalid_argument("Not a socket, refusing to replace: "s + path);
+        }
+        unlink(path.c_str());
+    }
+    if (bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        throw std::system_error(errno, std::generic_category(), "bind "s + path);
+    }
+    if (listen(listener.Get(), SOMAXCONN) < 0) {
+        throw std::system_error(errno, std::generic_category(), "listen "s + path);
+    }
+
+    while (true) {
+        FileDescriptor connection(accept(listener.Get(), nullptr, nullptr));
+        if (connection.Get() < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "accept");
+        }
+
+        // Строки могут приходить частями, поэтому хвост без '\n' ждёт следующего чтения
+        std::string pending;
+        char chunk[1 << 16];
+        bool connection_open = true;
+        while (connection_open) {
+            const ssize_t received = read(connection.Get(), chunk, sizeof(chunk));
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                // Последний запрос может прийти без '\n' перед закрытием записи клиентом;
+                // на него отвечаем так же, как при чтении из stdin
+                if (received == 0 && !IsBlank(pending)) {
+                    WriteAll(connection.Get(), HandleLine(pending) + '\n');
+                }
+                break;
+            }
+            pending.append(chunk, static_cast<size_t>(received));
+
+            size_t line_begin = 0;
+            for (size_t line_end; (line_end = pending.find('\n', line_begin)) != std::string::npos;
+                 line_begin = line_end + 1)
+            {
+                const std::string_view line(pending.data() + line_begin, line_end - line_begin);
+                if (IsBlank(line)) {
+                    continue;
+                }
+                if (!WriteAll(connection.Get(), HandleLine(line) + '\n')) {
+                    connection_open = false;
+                    break;
+                }
+            }
+            pending.erase(0, line_begin);
+            if (connection_open && pending.size() > MAX_SOCKET_LINE_SIZE) {
+                WriteAll(connection.Get(), ErrorResponse(nullptr, "request line is too long"s) + '\n');
+                break;
+            }
+        }
+    }
+#else
+    throw std::runtime_error("Unix sockets are not supported on this platform: "s + path);
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "json_reader.h"
+#include "metrics.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Строка журнала запросов: время прихода в микросекундах от начала записи,
+// табуляция и строка запроса в том виде, в каком она пришла
+struct CapturedRequest {
+    int64_t arrival_us = 0;
+    std::string_view line;
+};
+
+// nullopt, если строка не в формате журнала
+std::optional<CapturedRequest> ParseCapturedRequest(std::string_view log_line);
+
+// Долгоживущий режим работы: база загружается один раз, после чего сервер отвечает
+// на запросы из stat_requests, поступающие по одному JSON-объекту на строку.
+// Каждый ответ выводится компактно на отдельной строке. Каталог, граф маршрутов
+// и кэши рендеринга остаются прогретыми между запросами.
+// Запрос {"id": .., "type": "Update", "base_requests": [..]} дополняет базу.
+class QueryServer {
+public:
+    // Если передан latencies, в него записывается время обработки и сериализации
+    // каждого запроса
+    explicit QueryServer(JsonReader& reader, metrics::RequestLatencies* latencies = nullptr)
+        : reader_(reader), latencies_(latencies) {}
+
+    // Обрабатывает строки из input до конца потока
+    void Serve(std::istream& input, std::ostream& output);
+
+    // Принимает соединения на локальном Unix-сокете; каждое соединение
+    // обслуживается так же, как Serve, до закрытия клиентом. Файл по пути path
+    // заменяется, только если это сокет. Строка длиннее 64 МиБ получает ответ
+    // с ошибкой, и соединение закрывается
+    void ServeUnixSocket(const std::string& path);
+
+    // Каждая непустая строка запроса записывается в log со временем прихода;
+    // время отсчитывается от этого вызова
+    void SetCapture(std::ostream& log);
+
+    // Ответ на одну строку запроса, без завершающего перевода строки.
+    // Ошибки разбора возвращаются клиенту в поле error_message
+    std::string HandleLine(std::string_view line);
+
+private:
+    JsonReader& reader_;
+    metrics::RequestLatencies* latencies_;
+    std::ostream* capture_ = nullptr;
+    std::chrono::steady_clock::time_point capture_start_;
+
+    std::string ProcessRequest(const json::Dict& request);
+};
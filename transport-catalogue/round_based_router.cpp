@@ -0,0 +1,191 @@
+#include "round_based_router.h"
+#include "geo.h"
+#include "memory_report.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace transport {
+
+namespace {
+
+constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+constexpr uint32_t NO_POSITION = std::numeric_limits<uint32_t>::max();
+
+}  // namespace
+
+RoundBasedRouter::RoundBasedRouter(const transport_catalogue::TransportCatalogue& catalogue,
+                                   double bus_wait_time, double velocity_meters_per_minute)
+    : bus_wait_time_(bus_wait_time) {
+    TRACE_SCOPE("RoundBasedRouter");
+    for (const auto& stop : catalogue.GetStops()) {
+        stop_ids_.emplace(&stop, static_cast<uint32_t>(stops_.size()));
+        stops_.push_back(&stop);
+    }
+    lines_by_stop_.resize(stops_.size());
+
+    auto segment_time = [&](const transport_catalogue::Stop* from, const transport_catalogue::Stop* to) {
+        int distance = catalogue.GetDistance(from, to);
+        if (distance == 0) {
+            distance = static_cast<int>(ComputeDistance(from->coordinates, to->coordinates));
+        }
+        return distance / velocity_meters_per_minute;
+    };
+
+    auto add_line = [&](const transport_catalogue::Bus& bus, bool backward) {
+        Line line{&bus, backward, {}, {}};
+        const size_t count = bus.stops.size();
+        const transport_catalogue::Stop* previous = nullptr;
+        for (size_t i = 0; i < count; ++i) {
+            const auto* stop = bus.stops[backward ? count - 1 - i : i];
+            line.offsets.push_back(previous ? line.offsets.back() + segment_time(previous, stop) : 0.0);
+            line.stops.push_back(stop_ids_.at(stop));
+            previous = stop;
+        }
+        const auto line_id = static_cast<uint32_t>(lines_.size());
+        for (size_t i = 0; i < line.stops.size(); ++i) {
+            lines_by_stop_[line.stops[i]].push_back({line_id, static_cast<uint32_t>(i)});
+        }
+        lines_.push_back(std::move(line));
+    };
+
+    for (const auto& bus : catalogue.GetBuses()) {
+        if (bus.stops.size() < 2) {
+            continue;
+        }
+        add_line(bus, false);
+        if (!bus.is_roundtrip) {
+            add_line(bus, true);
+        }
+    }
+}
+
+std::vector<RoundBasedRouter::Journey> RoundBasedRouter::FindParetoJourneys(
+        const transport_catalogue::Stop* from,
+        const transport_catalogue::Stop* to,
+        size_t max_rides) const {
+    const auto from_it = stop_ids_.find(from);
+    const auto to_it = stop_ids_.find(to);
+    if (from_it == stop_ids_.end() || to_it == stop_ids_.end()) {
+        return {};
+    }
+    if (from == to) {
+        return {Journey{0.0, {}}};
+    }
+    const uint32_t source = from_it->second;
+    const uint32_t target = to_it->second;
+
+    // Поездка, которой достигнуто лучшее время: направление, позиции посадки
+    // и высадки и раунд, в котором она найдена
+    struct Ride {
+        uint32_t line = 0;
+        uint32_t board = NO_POSITION;
+        uint32_t alight = 0;
+        uint32_t round = 0;
+    };
+    // best[k][s] — лучшее время до s не более чем за k поездок
+    std::vector<std::vector<double>> best(1, std::vector<double>(stops_.size(), UNREACHED));
+    std::vector<std::vector<Ride>> rides(1, std::vector<Ride>(stops_.size()));
+    best[0][source] = 0.0;
+
+    std::vector<uint32_t> marked{source};
+    std::vector<uint32_t> first_position(lines_.size(), NO_POSITION);
+    std::vector<uint32_t> touched_lines;
+    std::vector<char> is_marked(stops_.size(), 0);
+
+    for (uint32_t round = 1; round <= max_rides && !marked.empty(); ++round) {
+        best.push_back(best.back());
+        rides.push_back(rides.back());
+        const auto& previous = best[round - 1];
+        auto& current = best[round];
+        auto& current_rides = rides[round];
+
+        // Каждое направление просматривается один раз, с самой ранней отмеченной остановки
+        touched_lines.clear();
+        for (const uint32_t stop : marked) {
+            for (const auto& [line, position] : lines_by_stop_[stop]) {
+                if (first_position[line] == NO_POSITION) {
+                    touched_lines.push_back(line);
+                }
+                first_position[line] = std::min(first_position[line], position);
+            }
+        }
+
+        std::vector<uint32_t> next_marked;
+        for (const uint32_t line_id : touched_lines) {
+            const Line& line = lines_[line_id];
+            uint32_t board = NO_POSITION;
+            double board_time = UNREACHED;
+            for (uint32_t position = first_position[line_id]; position < line.stops.size(); ++position) {
+                const uint32_t stop = line.stops[position];
+                if (board != NO_POSITION) {
+                    const double arrival = board_time + line.offsets[position] - line.offsets[board];
+                    // Не быстрее уже найденного пути до цели — дальше ехать незачем
+                    if (arrival < current[stop] && arrival < current[target]) {
+                        current[stop] = arrival;
+                        current_rides[stop] = {line_id, board, position, round};
+                        if (!is_marked[stop]) {
+                            is_marked[stop] = 1;
+                            next_marked.push_back(stop);
+                        }
+                    }
+                }
+                // Пересесть здесь выгоднее, если отсюда тот же автобус уходит позже
+                if (previous[stop] + bus_wait_time_
+                    < (board == NO_POSITION ? UNREACHED
+                                            : board_time + line.offsets[position] - line.offsets[board])) {
+                    board = position;
+                    board_time = previous[stop] + bus_wait_time_;
+                }
+            }
+            first_position[line_id] = NO_POSITION;
+        }
+        for (const uint32_t stop : next_marked) {
+            is_marked[stop] = 0;
+        }
+        marked = std::move(next_marked);
+    }
+
+    std::vector<Journey> journeys;
+    double best_time = UNREACHED;
+    for (uint32_t round = 1; round < best.size(); ++round) {
+        if (!(best[round][target] < best_time)) {
+            continue;
+        }
+        best_time = best[round][target];
+
+        Journey journey{best_time, {}};
+        uint32_t level = round;
+        for (uint32_t stop = target; stop != source;) {
+            const Ride& ride = rides[level][stop];
+            const Line& line = lines_[ride.line];
+            const size_t count = line.bus->stops.size();
+            journey.legs.push_back({line.bus,
+                                    line.backward ? count - 1 - ride.board : ride.board,
+                                    ride.alight - ride.board,
+                                    line.backward,
+                                    stops_[line.stops[ride.board]],
+                                    line.offsets[ride.alight] - line.offsets[ride.board]});
+            stop = line.stops[ride.board];
+            level = ride.round - 1;
+        }
+        std::reverse(journey.legs.begin(), journey.legs.end());
+        journeys.push_back(std::move(journey));
+    }
+    return journeys;
+}
+
+size_t RoundBasedRouter::GetMemoryUsage() const {
+    size_t bytes = memory::HeapBytes(stops_) + memory::HashTableBytes(stop_ids_)
+                   + memory::HeapBytes(lines_) + memory::HeapBytes(lines_by_stop_);
+    for (const auto& line : lines_) {
+        bytes += memory::HeapBytes(line.stops) + memory::HeapBytes(line.offsets);
+    }
+    for (const auto& by_stop : lines_by_stop_) {
+        bytes += memory::HeapBytes(by_stop);
+    }
+    return bytes;
+}
+
+}  // namespace transport
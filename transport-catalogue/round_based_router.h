@@ -0,0 +1,68 @@
+#pragma once
+
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace transport {
+
+// Поиск по раундам в духе RAPTOR для модели без расписаний: посадка стоит
+// bus_wait_time, поездка — расстояние, делённое на скорость. В раунде k
+// просматриваются только направления автобусов, проходящие через остановки,
+// до которых раунд k - 1 добрался быстрее, поэтому после k раундов известно
+// лучшее время с не более чем k поездками до каждой остановки. Время на
+// каждом шаге совпадает с весами графа TransportRouter.
+class RoundBasedRouter {
+public:
+    RoundBasedRouter(const transport_catalogue::TransportCatalogue& catalogue,
+                     double bus_wait_time, double velocity_meters_per_minute);
+
+    // Поездка одним автобусом: от bus->stops[first_stop_index] на span_count перегонов
+    struct Leg {
+        const transport_catalogue::Bus* bus;
+        size_t first_stop_index;
+        size_t span_count;
+        bool backward;
+        const transport_catalogue::Stop* from_stop;
+        double time;
+    };
+
+    struct Journey {
+        double total_time;
+        std::vector<Leg> legs;
+    };
+
+    // Парето-множество по (время, число поездок) среди маршрутов не более чем
+    // из max_rides поездок, по возрастанию числа поездок. Каждый следующий
+    // вариант строго быстрее предыдущего
+    std::vector<Journey> FindParetoJourneys(const transport_catalogue::Stop* from,
+                                            const transport_catalogue::Stop* to,
+                                            size_t max_rides) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    // Направление автобуса: остановки в порядке движения и время от первой из них
+    struct Line {
+        const transport_catalogue::Bus* bus;
+        bool backward;
+        std::vector<uint32_t> stops;
+        std::vector<double> offsets;
+    };
+
+    // Направление line проходит через остановку как position-я по счёту
+    struct LineStop {
+        uint32_t line;
+        uint32_t position;
+    };
+
+    double bus_wait_time_;
+    std::vector<const transport_catalogue::Stop*> stops_;
+    std::unordered_map<const transport_catalogue::Stop*, uint32_t> stop_ids_;
+    std::vector<Line> lines_;
+    std::vector<std::vector<LineStop>> lines_by_stop_;
+};
+
+}  // namespace transport
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "graph.h"
+#include "trace.h"
 
 #include <algorithm>
 #include <cassert>
@@ -29,6 +30,31 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+    // Вес кратчайшего пути из таблицы, без восстановления рёбер
+    std::optional<Weight> GetRouteWeight(VertexId from, VertexId to) const {
+        if (const auto& route_internal_data = routes_internal_data_[from][to]) {
+            return route_internal_data->weight;
+        }
+        return std::nullopt;
+    }
+
+    // Число ячеек таблицы кратчайших путей: квадрат числа вершин
+    size_t GetTableSize() const {
+        return routes_internal_data_.size() * routes_internal_data_.size();
+    }
+
+    // Байт в таблице кратчайших путей
+    size_t GetMemoryUsage() const {
+        return PredictMemoryUsage(routes_internal_data_.size());
+    }
+
+    // Сколько байт займёт таблица для графа из vertex_count вершин; позволяет
+    // отказаться от построения до того, как память будет выделена
+    static size_t PredictMemoryUsage(size_t vertex_count) {
+        return vertex_count * (sizeof(std::vector<std::optional<RouteInternalData>>)
+                               + vertex_count * sizeof(std::optional<RouteInternalData>));
+    }
+
 private:
     struct RouteInternalData {
         Weight weight;
@@ -86,6 +112,7 @@ Router<Weight>::Router(const Graph& graph)
     , routes_internal_data_(graph.GetVertexCount(),
                             std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
 {
+    TRACE_SCOPE_ARG("graph::Router", "vertices", static_cast<int64_t>(graph.GetVertexCount()));
     InitializeRoutesInternalData(graph);
 
     const size_t vertex_count = graph.GetVertexCount();
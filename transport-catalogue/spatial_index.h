@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Прямоугольник на плоскости, стороны параллельны осям
+struct Rect {
+    double min_x = 0;
+    double min_y = 0;
+    double max_x = 0;
+    double max_y = 0;
+
+    bool Intersects(const Rect& other) const {
+        return min_x <= other.max_x && other.min_x <= max_x
+            && min_y <= other.max_y && other.min_y <= max_y;
+    }
+};
+
+// Равномерная сетка над ограничивающим прямоугольником. Каждый объект попадает
+// во все ячейки, которые задевает его прямоугольник, поэтому запрос может
+// сообщить один и тот же идентификатор несколько раз. Объекты за пределами
+// границ прижимаются к крайним ячейкам.
+class GridIndex {
+public:
+    GridIndex() = default;
+
+    GridIndex(const Rect& bounds, size_t cells_per_side)
+        : bounds_(bounds)
+        , cells_per_side_(std::max<size_t>(cells_per_side, 1))
+        , cell_width_((bounds.max_x - bounds.min_x) / static_cast<double>(cells_per_side_))
+        , cell_height_((bounds.max_y - bounds.min_y) / static_cast<double>(cells_per_side_))
+        , cells_(cells_per_side_ * cells_per_side_) {
+    }
+
+    void Insert(uint32_t id, const Rect& rect) {
+        const auto [first_column, last_column] = ColumnRange(rect);
+        const auto [first_row, last_row] = RowRange(rect);
+        for (size_t row = first_row; row <= last_row; ++row) {
+            for (size_t column = first_column; column <= last_column; ++column) {
+                auto& cell = cells_[row * cells_per_side_ + column];
+                // Отрезки одной ломаной идут подряд, повторы в ячейке отсекаются здесь
+                if (cell.empty() || cell.back() != id) {
+                    cell.push_back(id);
+                }
+            }
+        }
+    }
+
+    template <typename Callback>
+    void Query(const Rect& rect, Callback&& callback) const {
+        if (cells_.empty() || !rect.Intersects(bounds_)) {
+            return;
+        }
+        const auto [first_column, last_column] = ColumnRange(rect);
+        const auto [first_row, last_row] = RowRange(rect);
+        for (size_t row = first_row; row <= last_row; ++row) {
+            for (size_t column = first_column; column <= last_column; ++column) {
+                for (const uint32_t id : cells_[row * cells_per_side_ + column]) {
+                    callback(id);
+                }
+            }
+        }
+    }
+
+private:
+    static size_t ToCell(double value, double origin, double cell_size, size_t cell_count) {
+        if (!(cell_size > 0)) {
+            return 0;
+        }
+        const double cell = std::floor((value - origin) / cell_size);
+        return static_cast<size_t>(std::clamp(cell, 0.0, static_cast<double>(cell_count - 1)));
+    }
+
+    std::pair<size_t, size_t> ColumnRange(const Rect& rect) const {
+        return {ToCell(rect.min_x, bounds_.min_x, cell_width_, cells_per_side_),
+                ToCell(rect.max_x, bounds_.min_x, cell_width_, cells_per_side_)};
+    }
+
+    std::pair<size_t, size_t> RowRange(const Rect& rect) const {
+        return {ToCell(rect.min_y, bounds_.min_y, cell_height_, cells_per_side_),
+                ToCell(rect.max_y, bounds_.min_y, cell_height_, cells_per_side_)};
+    }
+
+    Rect bounds_;
+    size_t cells_per_side_ = 0;
+    double cell_width_ = 0;
+    double cell_height_ = 0;
+    std::vector<std::vector<uint32_t>> cells_;
+};
@@ -1,4 +1,7 @@
 #include "svg.h"
+
+#include <algorithm>
+#include <charconv>
 #include <sstream>
 
 namespace svg {
@@ -9,7 +12,7 @@ using namespace std::literals;
 void Object::Render(const RenderContext& context) const {
     context.RenderIndent();
     RenderObject(context);
-    context.out << std::endl;
+    context.out << '\n';
 }
 
 Circle& Circle::SetCenter(Point center) {
@@ -143,4 +146,232 @@ void Document::RenderObject(const RenderContext& context) const {
     }
 }
 
-}
\ No newline at end of file
+namespace {
+
+// Больше знаков у double всё равно нет
+constexpr int MAX_COORDINATE_DECIMALS = 17;
+
+template <typename Number, typename... Format>
+void AppendNumber(std::string& buffer, Number value, Format... format) {
+    char chars[32];
+    const auto result = std::to_chars(chars, chars + sizeof(chars), value, format...);
+    buffer.append(chars, result.ptr);
+}
+
+std::string_view ToString(StrokeLineCap cap) {
+    switch (cap) {
+        case StrokeLineCap::BUTT:
+            return "butt"sv;
+        case StrokeLineCap::ROUND:
+            return "round"sv;
+        case StrokeLineCap::SQUARE:
+            return "square"sv;
+    }
+    return {};
+}
+
+std::string_view ToString(StrokeLineJoin join) {
+    switch (join) {
+        case StrokeLineJoin::ARCS:
+            return "arcs"sv;
+        case StrokeLineJoin::BEVEL:
+            return "bevel"sv;
+        case StrokeLineJoin::MITER:
+            return "miter"sv;
+        case StrokeLineJoin::MITER_CLIP:
+            return "miter-clip"sv;
+        case StrokeLineJoin::ROUND:
+            return "round"sv;
+    }
+    return {};
+}
+
+}  // namespace
+
+void Writer::WriteNumber(double value) {
+    // То же, что ostream << double: %g с шестью значащими цифрами
+    AppendNumber(buffer_, value, std::chars_format::general, 6);
+}
+
+void Writer::WriteNumber(uint32_t value) {
+    AppendNumber(buffer_, value);
+}
+
+void Writer::WriteCoordinate(double value) {
+    if (!coordinate_precision_) {
+        WriteNumber(value);
+        return;
+    }
+
+    const int decimals = std::clamp(*coordinate_precision_, 0, MAX_COORDINATE_DECIMALS);
+    char chars[64];
+    auto [end, error] = std::to_chars(chars, chars + sizeof(chars), value, std::chars_format::fixed, decimals);
+    if (error != std::errc{}) {
+        WriteNumber(value);
+        return;
+    }
+    if (decimals > 0) {
+        while (end[-1] == '0') {
+            --end;
+        }
+        if (end[-1] == '.') {
+            --end;
+        }
+    }
+    std::string_view text(chars, end - chars);
+    if (text == "-0"sv) {
+        text = "0"sv;
+    }
+    buffer_ += text;
+}
+
+void Writer::WriteColor(const Color& color) {
+    if (const auto* name = std::get_if<std::string>(&color)) {
+        buffer_ += *name;
+    } else if (const auto* rgb = std::get_if<Rgb>(&color)) {
+        buffer_ += "rgb("sv;
+        WriteNumber(uint32_t{rgb->red});
+        buffer_ += ',';
+        WriteNumber(uint32_t{rgb->green});
+        buffer_ += ',';
+        WriteNumber(uint32_t{rgb->blue});
+        buffer_ += ')';
+    } else if (const auto* rgba = std::get_if<Rgba>(&color)) {
+        buffer_ += "rgba("sv;
+        WriteNumber(uint32_t{rgba->red});
+        buffer_ += ',';
+        WriteNumber(uint32_t{rgba->green});
+        buffer_ += ',';
+        WriteNumber(uint32_t{rgba->blue});
+        buffer_ += ',';
+        WriteNumber(rgba->opacity);
+        buffer_ += ')';
+    } else {
+        buffer_ += "none"sv;
+    }
+}
+
+void Writer::WriteAttrs(const PathStyle& style) {
+    if (!style.class_name.empty()) {
+        buffer_ += " class=\""sv;
+        buffer_ += style.class_name;
+        buffer_ += '"';
+    }
+    if (style.fill_color) {
+        buffer_ += " fill=\""sv;
+        WriteColor(*style.fill_color);
+        buffer_ += '"';
+    }
+    if (style.stroke_color) {
+        buffer_ += " stroke=\""sv;
+        WriteColor(*style.stroke_color);
+        buffer_ += '"';
+    }
+    if (style.stroke_width) {
+        buffer_ += " stroke-width=\""sv;
+        WriteNumber(*style.stroke_width);
+        buffer_ += '"';
+    }
+    if (style.stroke_linecap) {
+        buffer_ += " stroke-linecap=\""sv;
+        buffer_ += ToString(*style.stroke_linecap);
+        buffer_ += '"';
+    }
+    if (style.stroke_linejoin) {
+        buffer_ += " stroke-linejoin=\""sv;
+        buffer_ += ToString(*style.stroke_linejoin);
+        buffer_ += '"';
+    }
+}
+
+void Writer::BeginDocument() {
+    buffer_ += "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+    buffer_ += "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
+}
+
+void Writer::EndDocument() {
+    buffer_ += "</svg>"sv;
+}
+
+void Writer::WriteStyleSheet(std::string_view css) {
+    buffer_ += "<style>"sv;
+    buffer_ += css;
+    buffer_ += "</style>\n"sv;
+}
+
+void Writer::WriteCircle(Point center, double radius, const PathStyle& style) {
+    buffer_ += "<circle cx=\""sv;
+    WriteCoordinate(center.x);
+    buffer_ += "\" cy=\""sv;
+    WriteCoordinate(center.y);
+    buffer_ += "\" r=\""sv;
+    WriteNumber(radius);
+    buffer_ += '"';
+    WriteAttrs(style);
+    buffer_ += "/>\n"sv;
+}
+
+void Writer::BeginPolyline() {
+    buffer_ += "<polyline points=\""sv;
+    first_point_ = true;
+}
+
+void Writer::AddPolylinePoint(Point point) {
+    if (!first_point_) {
+        buffer_ += ' ';
+    }
+    first_point_ = false;
+    WriteCoordinate(point.x);
+    buffer_ += ',';
+    WriteCoordinate(point.y);
+}
+
+void Writer::EndPolyline(const PathStyle& style) {
+    buffer_ += '"';
+    WriteAttrs(style);
+    buffer_ += " />\n"sv;
+}
+
+void Writer::WriteText(const TextProps& text, const PathStyle& style) {
+    buffer_ += "<text x=\""sv;
+    WriteCoordinate(text.position.x);
+    buffer_ += "\" y=\""sv;
+    WriteCoordinate(text.position.y);
+    buffer_ += "\" dx=\""sv;
+    WriteNumber(text.offset.x);
+    buffer_ += "\" dy=\""sv;
+    WriteNumber(text.offset.y);
+    buffer_ += '"';
+    if (text.font_size) {
+        buffer_ += " font-size=\""sv;
+        WriteNumber(*text.font_size);
+        buffer_ += '"';
+    }
+    if (!text.font_family.empty()) {
+        buffer_ += " font-family=\""sv;
+        buffer_ += text.font_family;
+        buffer_ += '"';
+    }
+    if (!text.font_weight.empty()) {
+        buffer_ += " font-weight=\""sv;
+        buffer_ += text.font_weight;
+        buffer_ += '"';
+    }
+    WriteAttrs(style);
+    buffer_ += '>';
+
+    for (char c : text.data) {
+        switch (c) {
+            case '"': buffer_ += "&quot;"sv; break;
+            case '\'': buffer_ += "&apos;"sv; break;
+            case '<': buffer_ += "&lt;"sv; break;
+            case '>': buffer_ += "&gt;"sv; break;
+            case '&': buffer_ += "&amp;"sv; break;
+            default: buffer_ += c;
+        }
+    }
+
+    buffer_ += "</text>\n"sv;
+}
+
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 #include <variant>
@@ -14,6 +15,8 @@ struct Rgb{
     uint8_t red;
     uint8_t green;
     uint8_t blue;
+
+    bool operator==(const Rgb&) const = default;
 };
 
 struct Rgba{
@@ -21,6 +24,8 @@ struct Rgba{
     uint8_t green;
     uint8_t blue;
     double opacity = 1;
+
+    bool operator==(const Rgba&) const = default;
 };
 using Color = std::variant<std::monostate, std::string, Rgb, Rgba>;
 inline const Color NoneColor = std::monostate();
@@ -272,4 +277,73 @@ private:
     std::vector<std::unique_ptr<Object>> objects_;
 };
 
+// Атрибуты контура для Writer. Цвета не копируются: на них ссылаются по указателю,
+// и они должны жить до конца вызова
+struct PathStyle {
+    // Классы из таблицы стилей документа; выводятся перед остальными атрибутами
+    std::string_view class_name;
+    const Color* fill_color = nullptr;
+    const Color* stroke_color = nullptr;
+    std::optional<double> stroke_width;
+    std::optional<StrokeLineCap> stroke_linecap;
+    std::optional<StrokeLineJoin> stroke_linejoin;
+};
+
+// Параметры текста для Writer; строки не копируются. Пустые шрифтовые
+// атрибуты не выводятся: их может задавать класс из таблицы стилей
+struct TextProps {
+    Point position;
+    Point offset;
+    std::optional<uint32_t> font_size = 1;
+    std::string_view font_family;
+    std::string_view font_weight;
+    std::string_view data;
+};
+
+// Пишет SVG-документ сразу в растущий буфер: без объектов на каждый элемент,
+// виртуальных вызовов и сбросов потока. Результат побайтово совпадает с тем,
+// что выводит Document::Render для таких же Circle, Polyline и Text.
+class Writer {
+public:
+    explicit Writer(std::string& buffer)
+        : buffer_(buffer) {}
+
+    void BeginDocument();
+    void EndDocument();
+
+    // Таблица стилей: элемент <style> с правилами css
+    void WriteStyleSheet(std::string_view css);
+
+    // Число знаков после точки в координатах точек, центров кругов и позиций текста;
+    // нули в конце дробной части отбрасываются. Без значения координаты выводятся
+    // как ostream << double
+    void SetCoordinatePrecision(std::optional<int> decimals) {
+        coordinate_precision_ = decimals;
+    }
+
+    void WriteCircle(Point center, double radius, const PathStyle& style);
+
+    void BeginPolyline();
+    void AddPolylinePoint(Point point);
+    void EndPolyline(const PathStyle& style);
+
+    void WriteText(const TextProps& text, const PathStyle& style);
+
+    // Вставляет готовые элементы, выведенные другим Writer
+    void WriteFragment(std::string_view fragment) {
+        buffer_ += fragment;
+    }
+
+private:
+    void WriteNumber(double value);
+    void WriteNumber(uint32_t value);
+    void WriteCoordinate(double value);
+    void WriteColor(const Color& color);
+    void WriteAttrs(const PathStyle& style);
+
+    std::string& buffer_;
+    bool first_point_ = true;
+    std::optional<int> coordinate_precision_;
+};
+
 } 
\ No newline at end of file
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Собирает программу и сравнивает её ответы на каждый вход testdata/NAME.json
+# с testdata/NAME.expected.json. Если рядом есть NAME.requests.ndjson, NAME.json —
+# база для --serve, а ответы на эти запросы сравниваются с NAME.expected.ndjson.
+# Запуск: sh transport-catalogue/testdata/run_tests.sh
+set -e
+testdata=$(cd "$(dirname "$0")" && pwd)
+sources=$(dirname "$testdata")
+binary=${TMPDIR:-/tmp}/transport_catalogue_tests
+
+g++ -std=c++20 -O2 -pthread "$sources"/*.cpp -o "$binary"
+
+status=0
+for input in "$testdata"/*.json; do
+    case "$input" in
+        *.expected.json) continue ;;
+    esac
+    name=$(basename "$input" .json)
+    if [ -f "$testdata/$name.requests.ndjson" ]; then
+        "$binary" --serve --base "$input" < "$testdata/$name.requests.ndjson" > "$binary.out" || true
+        expected="$testdata/$name.expected.ndjson"
+    else
+        "$binary" < "$input" > "$binary.out" || true
+        expected="$testdata/$name.expected.json"
+    fi
+    if diff -u "$expected" "$binary.out"; then
+        echo "ok   $name"
+    else
+        echo "FAIL $name"
+        status=1
+    fi
+done
+exit $status
@@ -0,0 +1,123 @@
+#include "trace.h"
+#include "json.h"
+
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+using namespace std::literals;
+
+namespace trace {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    std::string name;
+    std::string arg;
+    int thread_id;
+    double start_us;
+    double duration_us;
+};
+
+std::atomic<bool> enabled{false};
+Clock::time_point trace_start;
+std::mutex events_mutex;
+std::vector<Event> events;
+
+// Потоки нумеруются в порядке первого события, чтобы дорожки в просмотрщике были короткими
+int CurrentThreadId() {
+    static std::atomic<int> next_thread_id{1};
+    thread_local const int thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    return thread_id;
+}
+
+double Microseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+}  // namespace
+
+bool IsCompiledIn() {
+#ifdef TRANSPORT_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Start() {
+    std::lock_guard guard(events_mutex);
+    events.clear();
+    trace_start = Clock::now();
+    enabled.store(true, std::memory_order_release);
+}
+
+bool IsEnabled() {
+    return enabled.load(std::memory_order_acquire);
+}
+
+void WriteChromeTrace(std::ostream& output) {
+    std::lock_guard guard(events_mutex);
+    const auto flags = output.flags();
+    const auto precision = output.precision();
+    output << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& event : events) {
+        if (!first) {
+            output << ",\n";
+        }
+        first = false;
+        output << "{\"name\":\"" << json::EscapeString(event.name)
+               << "\",\"cat\":\"transport\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread_id
+               << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us;
+        if (!event.arg.empty()) {
+            output << ",\"args\":{" << event.arg << '}';
+        }
+        output << '}';
+    }
+    output << "],\"displayTimeUnit\":\"ms\"}\n";
+    output.flags(flags);
+    output.precision(precision);
+}
+
+Span::Span(std::string_view name)
+    : enabled_(IsEnabled()) {
+    if (enabled_) {
+        name_ = name;
+        start_ = Clock::now();
+    }
+}
+
+Span::Span(std::string_view name, std::string_view arg_name, std::string_view arg_value)
+    : enabled_(IsEnabled()) {
+    if (enabled_) {
+        name_ = name;
+        arg_ = "\""s + json::EscapeString(arg_name) + "\":\""s + json::EscapeString(arg_value) + "\""s;
+        start_ = Clock::now();
+    }
+}
+
+Span::Span(std::string_view name, std::string_view arg_name, int64_t arg_value)
+    : enabled_(IsEnabled()) {
+    if (enabled_) {
+        name_ = name;
+        arg_ = "\""s + json::EscapeString(arg_name) + "\":"s + std::to_string(arg_value);
+        start_ = Clock::now();
+    }
+}
+
+Span::~Span() {
+    if (!enabled_) {
+        return;
+    }
+    const auto end = Clock::now();
+    Event event{std::move(name_), std::move(arg_), CurrentThreadId(),
+                Microseconds(start_ - trace_start), Microseconds(end - start_)};
+    std::lock_guard guard(events_mutex);
+    events.push_back(std::move(event));
+}
+
+}  // namespace trace
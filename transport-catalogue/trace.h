@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Интервалы выполнения для просмотра в Perfetto / chrome://tracing.
+// TRACE_SCOPE(name) отмечает время от объявления до конца блока. Макросы
+// раскрываются в код, только если программа собрана с -DTRANSPORT_TRACE;
+// иначе их нет в бинарнике вовсе. В собранной с трассировкой программе запись
+// включается trace::Start(), до этого интервал стоит одну проверку флага.
+namespace trace {
+
+// Собрана ли программа с TRANSPORT_TRACE
+bool IsCompiledIn();
+
+// Начинает запись; время событий отсчитывается от этого вызова
+void Start();
+
+bool IsEnabled();
+
+// Пишет записанные события в формате Chrome trace_event
+void WriteChromeTrace(std::ostream& output);
+
+class Span {
+public:
+    explicit Span(std::string_view name);
+    Span(std::string_view name, std::string_view arg_name, std::string_view arg_value);
+    Span(std::string_view name, std::string_view arg_name, int64_t arg_value);
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    ~Span();
+
+private:
+    bool enabled_;
+    std::string name_;
+    // Аргумент события уже в виде JSON: "имя": значение
+    std::string arg_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifdef TRANSPORT_TRACE
+#define TRACE_SCOPE(name) ::trace::Span TRACE_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg_name, arg_value) \
+    ::trace::Span TRACE_CONCAT(trace_span_, __LINE__)(name, arg_name, arg_value)
+#else
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#define TRACE_SCOPE_ARG(name, arg_name, arg_value) static_cast<void>(0)
+#endif
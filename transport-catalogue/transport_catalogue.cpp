@@ -1,5 +1,6 @@
 #include "transport_catalogue.h"
 #include "geo.h"
+#include "trace.h"
 #include <algorithm>
 #include <optional>
 using namespace std;
@@ -9,9 +10,11 @@ namespace transport_catalogue {
     void TransportCatalogue::AddStop(string_view name, Coordinates coord) {
         stops_.push_back({ std::string(name), coord.lat, coord.lng });
         stopname_to_stop_[stops_.back().name] = &stops_.back();
+        ++version_;
     }
 
     void TransportCatalogue::AddBus(string_view name, const vector<string_view>& stop_names, bool is_roundtrip) {
+        TRACE_SCOPE_ARG("TransportCatalogue::AddBus", "bus", name);
         std::vector<const Stop*> bus_stops;
         bus_stops.reserve(stop_names.size());
 
@@ -22,7 +25,7 @@ namespace transport_catalogue {
             }
         }
 
-        buses_.push_back({ std::string(name), std::move(bus_stops), is_roundtrip });
+        buses_.push_back({ std::string(name), std::move(bus_stops), is_roundtrip, {} });
         busname_to_bus_[buses_.back().name] = &buses_.back();
 
         for (const Stop* stop : buses_.back().stops) {
@@ -30,10 +33,18 @@ namespace transport_catalogue {
                 stop_to_buses_[stop].insert(&buses_.back());
             }
         }
-
+        ++version_;
     }
 
 
+    void TransportCatalogue::SetBusDepartures(string_view bus_name, vector<double> departures) {
+        if (auto it = busname_to_bus_.find(bus_name); it != busname_to_bus_.end()) {
+            std::sort(departures.begin(), departures.end());
+            it->second->departures = std::move(departures);
+            ++version_;
+        }
+    }
+
     const Stop* TransportCatalogue::FindStop(string_view name) const {
         if (auto it = stopname_to_stop_.find(name); it != stopname_to_stop_.end()) {
             return it->second;
@@ -108,6 +119,7 @@ const std::unordered_set<const Bus*>& TransportCatalogue::GetBusesByStop(std::st
 }
     void TransportCatalogue::SetDistance(const Stop* from, const Stop* to, int distance) {
         distances_[{from, to}] = distance;
+        ++version_;
     }
 
     int TransportCatalogue::GetDistance(const Stop* from, const Stop* to) const {
@@ -125,4 +137,35 @@ const std::unordered_set<const Bus*>& TransportCatalogue::GetBusesByStop(std::st
     const std::deque<Stop>& TransportCatalogue::GetStops() const { 
         return stops_;
     }
+    uint64_t TransportCatalogue::GetVersion() const {
+        return version_;
+    }
+    memory::MemoryReport TransportCatalogue::GetMemoryReport() const {
+        memory::MemoryReport report;
+
+        size_t stops = memory::HeapBytes(stops_);
+        for (const auto& stop : stops_) {
+            stops += memory::HeapBytes(stop.name);
+        }
+        report.Add("catalogue.stops", stops);
+
+        size_t buses = memory::HeapBytes(buses_);
+        for (const auto& bus : buses_) {
+            buses += memory::HeapBytes(bus.name) + memory::HeapBytes(bus.stops)
+                     + memory::HeapBytes(bus.departures);
+        }
+        report.Add("catalogue.buses", buses);
+
+        report.Add("catalogue.name_index",
+                   memory::HashTableBytes(stopname_to_stop_) + memory::HashTableBytes(busname_to_bus_));
+
+        size_t stop_to_buses = memory::HashTableBytes(stop_to_buses_);
+        for (const auto& [stop, stop_buses] : stop_to_buses_) {
+            stop_to_buses += memory::HashTableBytes(stop_buses);
+        }
+        report.Add("catalogue.stop_to_buses", stop_to_buses);
+
+        report.Add("catalogue.distances", memory::HashTableBytes(distances_));
+        return report;
+    }
 }
\ No newline at end of file
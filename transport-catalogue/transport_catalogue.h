@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <string_view>
@@ -7,6 +8,7 @@
 #include <deque>
 #include <optional>
 #include "geo.h"
+#include "memory_report.h"
 
 namespace transport_catalogue {
     
@@ -19,6 +21,9 @@ namespace transport_catalogue {
         std::string name;
         std::vector<const Stop*> stops;
         bool is_roundtrip;
+        // Моменты отправления рейсов от начальной остановки в минутах от начала
+        // суток, по возрастанию; пусто, если расписания нет
+        std::vector<double> departures;
     };
 
     struct BusInfo {
@@ -38,17 +43,23 @@ namespace transport_catalogue {
         const Stop* FindStop(std::string_view name) const;
         const Bus* FindBus(std::string_view name) const;
         const std::unordered_set<const Bus*>& GetBusesByStop(std::string_view stop_name) const;
+        // Задаёт расписание автобуса; моменты сортируются
+        void SetBusDepartures(std::string_view bus_name, std::vector<double> departures);
         void SetDistance(const Stop* from, const Stop* to, int distance);
         int GetDistance(const Stop* from, const Stop* to) const;
         const std::deque<Bus>& GetBuses() const;
         const std::deque<Stop>& GetStops() const;
+        // Растёт при каждом изменении каталога; по нему сбрасываются производные кэши
+        uint64_t GetVersion() const;
+        // Память остановок, автобусов, индексов по имени, списков автобусов остановок и расстояний
+        memory::MemoryReport GetMemoryReport() const;
 
     private:
         std::deque<Stop> stops_;
         std::deque<Bus> buses_;
 
         std::unordered_map<std::string_view, const Stop*> stopname_to_stop_;
-        std::unordered_map<std::string_view, const Bus*> busname_to_bus_;
+        std::unordered_map<std::string_view, Bus*> busname_to_bus_;
         std::unordered_map<const Stop*, std::unordered_set<const Bus*>> stop_to_buses_;
         struct StopPairHasher {
             size_t operator()(const std::pair<const Stop*, const Stop*>& p) const {
@@ -56,6 +67,7 @@ namespace transport_catalogue {
             }
         };
         std::unordered_map<std::pair<const Stop*, const Stop*>, int, StopPairHasher> distances_;
+        uint64_t version_ = 0;
     };
 
 } 
\ No newline at end of file
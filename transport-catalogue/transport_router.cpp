@@ -1,28 +1,97 @@
 #include "transport_router.h"
 #include "geo.h"
+#include "k_shortest_paths.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+using namespace std::literals;
 
 namespace transport {
 
+namespace {
+
+// Маршрут по расписанию в виде ответа Route: ожидание до отправления рейса и поездка
+TransportRouter::RouteInfo MakeRouteInfo(const ConnectionScanRouter::Journey& journey) {
+    using RouteItem = TransportRouter::RouteItem;
+    TransportRouter::RouteInfo result;
+    result.total_time = journey.arrival_time - journey.departure_time;
+    double now = journey.departure_time;
+    for (const auto& leg : journey.legs) {
+        result.items.push_back(RouteItem{
+            RouteItem::Type::WAIT,
+            leg.from_stop->name,
+            "",
+            leg.board_time - now,
+            0
+        });
+        result.items.push_back(RouteItem{
+            RouteItem::Type::BUS,
+            "",
+            leg.bus->name,
+            leg.alight_time - leg.board_time,
+            static_cast<int>(leg.span_count),
+            leg.first_stop_index,
+            leg.backward,
+            leg.bus
+        });
+        now = leg.alight_time;
+    }
+    return result;
+}
+
+// По возрастанию времени, при равном — по названию остановки
+void SortByTime(std::vector<TransportRouter::ReachableStop>& stops) {
+    std::sort(stops.begin(), stops.end(), [](const auto& lhs, const auto& rhs) {
+        return std::tie(lhs.time, lhs.stop->name) < std::tie(rhs.time, rhs.stop->name);
+    });
+}
+
+}  // namespace
+
 TransportRouter::TransportRouter(const RoutingSettings& settings,
                                 const transport_catalogue::TransportCatalogue& catalogue)
     : settings_(settings)
     , catalogue_(catalogue) {}
 
 void TransportRouter::BuildGraph() {
+    TRACE_SCOPE("TransportRouter::BuildGraph");
+    if (router_memory_limit_) {
+        if (const size_t predicted = PredictRouterTableBytes(); predicted > *router_memory_limit_) {
+            throw std::length_error("Router table needs "s + std::to_string(predicted)
+                                    + " bytes, limit is "s + std::to_string(*router_memory_limit_));
+        }
+    }
+
     stops_.clear();
     stop_ids_.clear();
     edges_.clear();
     edge_to_bus_info_.clear();
     graph_.reset();
     router_.reset();
+    round_based_router_.reset();
+    timetable_router_.reset();
 
     InitializeStops();
     ProcessBusRoutes();
 
     router_ = std::make_unique<graph::Router<double>>(*graph_);
+    round_based_router_ = std::make_unique<RoundBasedRouter>(
+        catalogue_, settings_.bus_wait_time, settings_.bus_velocity * VELOCITY_COEF);
+
+    const auto& buses = catalogue_.GetBuses();
+    if (std::any_of(buses.begin(), buses.end(), [](const auto& bus) { return !bus.departures.empty(); })) {
+        timetable_router_ = std::make_unique<ConnectionScanRouter>(
+            catalogue_, settings_.bus_velocity * VELOCITY_COEF);
+    }
 }
 
 void TransportRouter::InitializeStops() {
+    TRACE_SCOPE("TransportRouter::InitializeStops");
     const auto& all_stops = catalogue_.GetStops();
     stops_.reserve(all_stops.size());
 
@@ -45,6 +114,7 @@ void TransportRouter::InitializeStops() {
 }
 
 void TransportRouter::ProcessBusRoutes() {
+    TRACE_SCOPE("TransportRouter::ProcessBusRoutes");
     const auto& all_buses = catalogue_.GetBuses();
 
     for (const auto& bus : all_buses) {
@@ -61,6 +131,7 @@ void TransportRouter::ProcessBusRoutes() {
 }
 
 void TransportRouter::ProcessRoundTripBus(const transport_catalogue::Bus& bus) {
+    TRACE_SCOPE_ARG("TransportRouter::ProcessRoundTripBus", "bus", bus.name);
     const auto& stops = bus.stops;
     const size_t stop_count = stops.size();
 
@@ -88,7 +159,10 @@ void TransportRouter::ProcessRoundTripBus(const transport_catalogue::Bus& bus) {
                 stops[j]->name,
                 bus.name,
                 static_cast<int>(j - i),
-                time
+                time,
+                i,
+                false,
+                &bus
             };
 
             edges_.push_back(edge);
@@ -98,6 +172,7 @@ void TransportRouter::ProcessRoundTripBus(const transport_catalogue::Bus& bus) {
 }
 
 void TransportRouter::ProcessLinearBus(const transport_catalogue::Bus& bus) {
+    TRACE_SCOPE_ARG("TransportRouter::ProcessLinearBus", "bus", bus.name);
     const auto& stops = bus.stops;
     const size_t stop_count = stops.size();
 
@@ -126,7 +201,10 @@ void TransportRouter::ProcessLinearBus(const transport_catalogue::Bus& bus) {
                 stops[j]->name,
                 bus.name,
                 static_cast<int>(j - i),
-                time
+                time,
+                i,
+                false,
+                &bus
             };
 
             edges_.push_back(edge);
@@ -159,7 +237,10 @@ void TransportRouter::ProcessLinearBus(const transport_catalogue::Bus& bus) {
                 stops[j]->name,
                 bus.name,
                 static_cast<int>(i - j),
-                time
+                time,
+                i,
+                true,
+                &bus
             };
 
             edges_.push_back(edge);
@@ -186,11 +267,121 @@ std::optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(const std::
     if (!route) {
         return std::nullopt;
     }
+    return BuildRouteInfo(*route);
+}
+
+std::vector<TransportRouter::RouteInfo> TransportRouter::FindRoutes(const std::string& from,
+                                                                   const std::string& to,
+                                                                   size_t count) const {
+    // Тот же порядок проверок, что и в FindRoute: первый маршрут совпадает с его ответом
+    if (count == 0) {
+        return {};
+    }
+    if (from == to) {
+        return {RouteInfo{0.0, {}}};
+    }
+    if (!stop_ids_.count(from) || !stop_ids_.count(to)) {
+        return {};
+    }
 
+    // Поездки пути и остановки, через которые он на самом деле проезжает:
+    // путь без повторных вершин графа ещё может дважды пройти одну остановку,
+    // проезжая её внутри поездки
+    struct Ride {
+        std::vector<const BusEdge*> legs;
+        std::vector<const transport_catalogue::Stop*> stops;
+    };
+    auto get_ride = [this](const graph::Router<double>::RouteInfo& route) {
+        Ride ride;
+        for (const auto edge_id : route.edges) {
+            const auto it = edge_to_bus_info_.find(edge_id);
+            if (it == edge_to_bus_info_.end()) {
+                continue;
+            }
+            const BusEdge& bus_edge = it->second;
+            const auto& stops = bus_edge.bus->stops;
+            for (int span = 0; span <= bus_edge.span_count; ++span) {
+                const size_t index = bus_edge.backward ? bus_edge.first_stop_index - span
+                                                       : bus_edge.first_stop_index + span;
+                // Остановка пересадки — последняя остановка предыдущей поездки
+                if (span > 0 || ride.stops.empty()) {
+                    ride.stops.push_back(stops[index]);
+                }
+            }
+            ride.legs.push_back(&bus_edge);
+        }
+        return ride;
+    };
+
+    // Объезд: остановка пройдена дважды или автобус сразу везёт обратно
+    // по той же линии, по которой только что приехали
+    auto is_loop = [](const Ride& ride) {
+        for (size_t i = 1; i < ride.legs.size(); ++i) {
+            if (ride.legs[i - 1]->bus == ride.legs[i]->bus
+                && ride.legs[i - 1]->backward != ride.legs[i]->backward) {
+                return true;
+            }
+        }
+        auto stops = ride.stops;
+        std::sort(stops.begin(), stops.end());
+        return std::adjacent_find(stops.begin(), stops.end()) != stops.end();
+    };
+
+    // Перегоны между соседними остановками, которые проезжает путь
+    using Hop = std::pair<const transport_catalogue::Stop*, const transport_catalogue::Stop*>;
+    auto get_hops = [](const Ride& ride) {
+        std::vector<Hop> hops;
+        for (size_t i = 1; i < ride.stops.size(); ++i) {
+            hops.emplace_back(ride.stops[i - 1], ride.stops[i]);
+        }
+        std::sort(hops.begin(), hops.end());
+        hops.erase(std::unique(hops.begin(), hops.end()), hops.end());
+        return hops;
+    };
+
+    std::vector<std::vector<Hop>> accepted_hops;
+    auto is_distinct = [&](const graph::Router<double>::RouteInfo& route) {
+        const Ride ride = get_ride(route);
+        // Первый путь — ответ FindRoute, он принимается как есть
+        if (!accepted_hops.empty() && is_loop(ride)) {
+            return false;
+        }
+        auto hops = get_hops(ride);
+        for (const auto& other : accepted_hops) {
+            size_t common = 0;
+            for (auto lhs = hops.cbegin(), rhs = other.cbegin(); lhs != hops.cend() && rhs != other.cend();) {
+                if (*lhs < *rhs) {
+                    ++lhs;
+                } else if (*rhs < *lhs) {
+                    ++rhs;
+                } else {
+                    ++common, ++lhs, ++rhs;
+                }
+            }
+            // Доля общих перегонов среди всех перегонов обоих маршрутов
+            const size_t total = hops.size() + other.size() - common;
+            if (total > 0 && common >= MAX_ROUTE_OVERLAP * total) {
+                return false;
+            }
+        }
+        accepted_hops.push_back(std::move(hops));
+        return true;
+    };
+
+    graph::KShortestPaths<double> paths(*graph_, *router_);
+    std::vector<RouteInfo> result;
+    for (const auto& route : paths.Find(stop_ids_.at(from) * 2, stop_ids_.at(to) * 2, count,
+                                        count * PATHS_PER_ALTERNATIVE, is_distinct)) {
+        result.push_back(BuildRouteInfo(route));
+    }
+    return result;
+}
+
+TransportRouter::RouteInfo TransportRouter::BuildRouteInfo(const graph::Router<double>::RouteInfo& route) const {
     RouteInfo result;
-    result.total_time = route->weight;
+    result.total_time = route.weight;
 
-    for (auto edge_id : route->edges) {
+    for (auto edge_id : route.edges) {
         const auto& edge = graph_->GetEdge(edge_id);
 
         if (edge.from % 2 == 0 && edge.to == edge.from + 1) {
@@ -210,7 +401,10 @@ std::optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(const std::
                     "",
                     bus_edge.bus_name,
                     bus_edge.time,
-                    bus_edge.span_count
+                    bus_edge.span_count,
+                    bus_edge.first_stop_index,
+                    bus_edge.backward,
+                    bus_edge.bus
                 });
             }
         }
@@ -219,4 +413,155 @@ std::optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(const std::
     return result;
 }
 
+std::optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(const std::string& from,
+                                                                    const std::string& to,
+                                                                    double departure_time) const {
+    if (!timetable_router_) {
+        return std::nullopt;
+    }
+    const auto journey = timetable_router_->FindJourney(catalogue_.FindStop(from), catalogue_.FindStop(to),
+                                                        departure_time);
+    if (!journey) {
+        return std::nullopt;
+    }
+
+    return MakeRouteInfo(*journey);
+}
+
+std::vector<TransportRouter::RouteInfo> TransportRouter::FindRouteOptions(const std::string& from,
+                                                                         const std::string& to,
+                                                                         size_t max_transfers) const {
+    std::vector<RouteInfo> options;
+    if (!round_based_router_) {
+        return options;
+    }
+    for (const auto& journey : round_based_router_->FindParetoJourneys(
+             catalogue_.FindStop(from), catalogue_.FindStop(to), max_transfers + 1)) {
+        RouteInfo route;
+        route.total_time = journey.total_time;
+        for (const auto& leg : journey.legs) {
+            route.items.push_back(RouteItem{
+                RouteItem::Type::WAIT,
+                leg.from_stop->name,
+                "",
+                settings_.bus_wait_time,
+                0
+            });
+            route.items.push_back(RouteItem{
+                RouteItem::Type::BUS,
+                "",
+                leg.bus->name,
+                leg.time,
+                static_cast<int>(leg.span_count),
+                leg.first_stop_index,
+                leg.backward,
+                leg.bus
+            });
+        }
+        options.push_back(std::move(route));
+    }
+    return options;
+}
+
+std::vector<TransportRouter::RouteInfo> TransportRouter::FindRouteOptions(const std::string& from,
+                                                                         const std::string& to,
+                                                                         size_t max_transfers,
+                                                                         double departure_time) const {
+    std::vector<RouteInfo> options;
+    if (!timetable_router_) {
+        return options;
+    }
+    for (const auto& journey : timetable_router_->FindParetoJourneys(
+             catalogue_.FindStop(from), catalogue_.FindStop(to), departure_time, max_transfers + 1)) {
+        options.push_back(MakeRouteInfo(journey));
+    }
+    return options;
+}
+
+std::optional<std::vector<TransportRouter::ReachableStop>> TransportRouter::FindReachableStops(
+        const std::string& from, double max_time) const {
+    const auto from_it = stop_ids_.find(from);
+    if (from_it == stop_ids_.end()) {
+        return std::nullopt;
+    }
+    // Строка таблицы для вершины ожидания from — время до всех остальных вершин
+    std::vector<ReachableStop> result;
+    for (size_t stop = 0; stop < stops_.size(); ++stop) {
+        const auto time = router_->GetRouteWeight(from_it->second * 2, stop * 2);
+        if (time && *time <= max_time) {
+            result.push_back({catalogue_.FindStop(stops_[stop]), *time});
+        }
+    }
+    SortByTime(result);
+    return result;
+}
+
+std::optional<std::vector<TransportRouter::ReachableStop>> TransportRouter::FindReachableStops(
+        const std::string& from, double max_time, double departure_time) const {
+    const auto* stop = catalogue_.FindStop(from);
+    if (!timetable_router_ || !stop) {
+        return std::nullopt;
+    }
+    std::vector<ReachableStop> result;
+    for (const auto& [reached, arrival] : timetable_router_->FindArrivals(stop, departure_time,
+                                                                         departure_time + max_time)) {
+        result.push_back({reached, arrival - departure_time});
+    }
+    SortByTime(result);
+    return result;
+}
+
+size_t TransportRouter::GetVertexCount() const {
+    return graph_ ? graph_->GetVertexCount() : 0;
+}
+
+size_t TransportRouter::GetEdgeCount() const {
+    return graph_ ? graph_->GetEdgeCount() : 0;
+}
+
+size_t TransportRouter::GetRouterTableSize() const {
+    return router_ ? router_->GetTableSize() : 0;
+}
+
+memory::MemoryReport TransportRouter::GetMemoryReport() const {
+    memory::MemoryReport report;
+
+    size_t stops = memory::HeapBytes(stops_) + memory::HashTableBytes(stop_ids_);
+    for (const auto& name : stops_) {
+        stops += memory::HeapBytes(name);
+    }
+    for (const auto& [name, id] : stop_ids_) {
+        stops += memory::HeapBytes(name);
+    }
+    report.Add("router.stops", stops);
+
+    report.Add("router.graph", graph_ ? sizeof(*graph_) + graph_->GetMemoryUsage() : 0);
+
+    auto edge_bytes = [](const BusEdge& edge) {
+        return memory::HeapBytes(edge.from_stop) + memory::HeapBytes(edge.to_stop)
+               + memory::HeapBytes(edge.bus_name);
+    };
+    size_t edges = memory::HeapBytes(edges_);
+    for (const auto& edge : edges_) {
+        edges += edge_bytes(edge);
+    }
+    report.Add("router.edges", edges);
+
+    size_t edge_to_bus_info = memory::HashTableBytes(edge_to_bus_info_);
+    for (const auto& [id, edge] : edge_to_bus_info_) {
+        edge_to_bus_info += edge_bytes(edge);
+    }
+    report.Add("router.edge_to_bus_info", edge_to_bus_info);
+
+    report.Add("router.table", router_ ? sizeof(*router_) + router_->GetMemoryUsage() : 0);
+    report.Add("router.round_based", round_based_router_ ? sizeof(*round_based_router_) + round_based_router_->GetMemoryUsage() : 0);
+    report.Add("router.timetable", timetable_router_ ? sizeof(*timetable_router_) + timetable_router_->GetMemoryUsage() : 0);
+    return report;
+}
+
+size_t TransportRouter::PredictRouterTableBytes() const {
+    // Две вершины на остановку: ожидание и посадка
+    return graph::Router<double>::PredictMemoryUsage(catalogue_.GetStops().size() * 2);
+}
+
 }  // namespace transport
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "connection_scan.h"
 #include "graph.h"
+#include "round_based_router.h"
+#include "memory_report.h"
 #include "router.h"
 #include "transport_catalogue.h"
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -22,6 +26,12 @@ struct BusEdge {
     std::string bus_name;
     int span_count;
     double time;
+    // Откуда начинается поездка в bus->stops и в какую сторону по ним
+    size_t first_stop_index = 0;
+    bool backward = false;
+    // Автобус, по которому построено ребро: по имени после Update мог бы
+    // найтись другой, и индексы остановок указывали бы мимо его списка
+    const transport_catalogue::Bus* bus = nullptr;
 };
 
 class TransportRouter {
@@ -39,6 +49,11 @@ public:
         std::string bus_name;
         double time;
         int span_count;
+        // Для поездки: номер остановки посадки в bus->stops, направление движения
+        // и сам автобус
+        size_t first_stop_index = 0;
+        bool backward = false;
+        const transport_catalogue::Bus* bus = nullptr;
     };
 
     struct RouteInfo {
@@ -48,11 +63,68 @@ public:
 
     std::optional<RouteInfo> FindRoute(const std::string& from, const std::string& to) const;
 
+    // До count заметно различающихся маршрутов в порядке неубывания времени;
+    // первый совпадает с FindRoute. Остальные не проезжают ни одну остановку
+    // дважды и не возвращаются тем же автобусом назад. Маршрут, чьи перегоны
+    // почти те же, что у уже выбранного, пропускается
+    std::vector<RouteInfo> FindRoutes(const std::string& from, const std::string& to, size_t count) const;
+
+    // Маршрут по расписаниям автобусов с отправлением не раньше departure_time
+    // (минуты от начала суток). Ожидание — время до отправления рейса, total_time
+    // считается от departure_time до прибытия. nullopt, если расписаний нет
+    // или до цели не доехать
+    std::optional<RouteInfo> FindRoute(const std::string& from, const std::string& to,
+                                       double departure_time) const;
+
+    // Варианты маршрута, не сравнимые между собой по времени и числу пересадок:
+    // по возрастанию числа пересадок, каждый следующий строго быстрее. Пересадок
+    // не больше max_transfers; с departure_time варианты строятся по расписаниям
+    std::vector<RouteInfo> FindRouteOptions(const std::string& from, const std::string& to,
+                                            size_t max_transfers) const;
+    std::vector<RouteInfo> FindRouteOptions(const std::string& from, const std::string& to,
+                                            size_t max_transfers, double departure_time) const;
+
+    // Остановка, до которой можно доехать за time минут
+    struct ReachableStop {
+        const transport_catalogue::Stop* stop;
+        double time;
+    };
+
+    // Все остановки, до которых из from можно доехать не дольше чем за max_time,
+    // по возрастанию времени; from — с нулевым временем. Время до остановки
+    // берётся из таблицы маршрутизатора, так что поиска не требуется.
+    // nullopt, если остановки from нет
+    std::optional<std::vector<ReachableStop>> FindReachableStops(const std::string& from, double max_time) const;
+    // То же по расписаниям при отправлении не раньше departure_time;
+    // nullopt, если расписаний нет
+    std::optional<std::vector<ReachableStop>> FindReachableStops(const std::string& from, double max_time,
+                                                                 double departure_time) const;
+
+    // Размеры построенного графа и таблицы маршрутизатора; 0, пока граф не построен
+    size_t GetVertexCount() const;
+    size_t GetEdgeCount() const;
+    size_t GetRouterTableSize() const;
+
+    // Память графа, рёбер и таблицы маршрутизатора
+    memory::MemoryReport GetMemoryReport() const;
+
+    // Сколько байт займёт таблица маршрутизатора, если построить граф
+    // по текущему содержимому каталога
+    size_t PredictRouterTableBytes() const;
+
+    // Если предсказанная таблица больше limit байт, BuildGraph бросает
+    // std::length_error и оставляет прежний граф
+    void SetRouterMemoryLimit(std::optional<size_t> limit) {
+        router_memory_limit_ = limit;
+    }
+
 private:
     void InitializeStops();
     void ProcessBusRoutes();
     void ProcessRoundTripBus(const transport_catalogue::Bus& bus);
     void ProcessLinearBus(const transport_catalogue::Bus& bus);
+    // Ожидания и поездки по рёбрам пути в графе
+    RouteInfo BuildRouteInfo(const graph::Router<double>::RouteInfo& route) const;
 
 private:
     RoutingSettings settings_;
@@ -63,11 +135,21 @@ private:
 
     std::unique_ptr<graph::DirectedWeightedGraph<double>> graph_;
     std::unique_ptr<graph::Router<double>> router_;
+    std::unique_ptr<RoundBasedRouter> round_based_router_;
+    // Строится, только если хотя бы у одного автобуса есть расписание
+    std::unique_ptr<ConnectionScanRouter> timetable_router_;
 
     std::vector<BusEdge> edges_;
     std::unordered_map<graph::EdgeId, BusEdge> edge_to_bus_info_;
 
+    std::optional<size_t> router_memory_limit_;
+
     static constexpr double VELOCITY_COEF = 1000.0 / 60.0; // скорость в м/мин
+    // Маршрут не считается отдельным вариантом, если хотя бы такая доля перегонов
+    // общая с уже выбранным
+    static constexpr double MAX_ROUTE_OVERLAP = 0.8;
+    // Сколько путей алгоритм Йена просматривает на каждый запрошенный маршрут
+    static constexpr size_t PATHS_PER_ALTERNATIVE = 20;
 };
 
 }  // namespace transport